@@ -0,0 +1,155 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * Throughput benchmarks for the encoder and decoder.
+ *
+ * Every combination of payload size, escape density and chunk size is timed
+ * for at least the given number of seconds (0.05 by default), and the results
+ * are printed as CSV so runs can be compared. Throughput is measured in
+ * decoded payload bytes.
+ *
+ * Usage: bench_kiss [seconds_per_case]
+ */
+
+#include <kiss.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const size_t SIZES[] = {16, 64, 256, 1024, 4096, 16384, 65536};
+#define SIZE_COUNT (sizeof(SIZES) / sizeof(SIZES[0]))
+
+// Percent of payload bytes that need escaping, 100 is all FEND
+static const int DENSITIES[] = {0, 1, 50, 100};
+#define DENSITY_COUNT (sizeof(DENSITIES) / sizeof(DENSITIES[0]))
+
+// Bytes handed to the streaming decoder per call, 0 is the whole frame
+static const size_t CHUNKS[] = {1, 16, 256, 0};
+#define CHUNK_COUNT (sizeof(CHUNKS) / sizeof(CHUNKS[0]))
+
+#define MAX_SIZE 65536
+
+static uint8_t decoded[MAX_SIZE];
+static uint8_t encoded[MAX_SIZE * 2 + 3];
+static uint8_t output[MAX_SIZE * 2 + 3];
+static size_t encoded_length;
+static size_t payload_length;
+static size_t chunk_size;
+
+// Keeps the compiler from removing the work being measured
+static volatile size_t sink;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void fill_payload(size_t size, int density) {
+    srand(1);
+    for (size_t i = 0; i < size; i++) {
+        if (density == 100) {
+            decoded[i] = KISS_FRAME_END;
+        } else if (rand() % 100 < density) {
+            decoded[i] = (rand() & 1) ? KISS_FRAME_END : KISS_FRAME_ESCAPE;
+        } else {
+            // Anything but FEND and FESC
+            uint8_t b = (uint8_t) rand();
+            decoded[i] = (b == KISS_FRAME_END || b == KISS_FRAME_ESCAPE) ? 'A' : b;
+        }
+    }
+    payload_length = size;
+    kiss_packet_t p = kiss_new_packet(decoded, size);
+    p.data_length = size;
+    encoded_length = kiss_encode_packet(p, encoded, sizeof(encoded));
+}
+
+static void run_encode_data(void) {
+    sink += kiss_encode_data(decoded, payload_length, output, sizeof(output));
+}
+
+static void run_decode_data(void) {
+    // Skip the FEND and command byte, and the closing FEND
+    sink += kiss_decode_data(encoded + 2, encoded_length - 3, output, sizeof(output));
+}
+
+static void run_encode_packet(void) {
+    kiss_packet_t p = kiss_new_packet(decoded, payload_length);
+    p.data_length = payload_length;
+    sink += kiss_encode_packet(p, output, sizeof(output));
+}
+
+static void run_decode_packet(void) {
+    kiss_packet_t p = kiss_new_packet(output, sizeof(output));
+    sink += kiss_decode_packet(&p, encoded, encoded_length);
+}
+
+static void run_decoder_push(void) {
+    kiss_decoder_t d = kiss_new_decoder(output, sizeof(output));
+    size_t step = chunk_size ? chunk_size : encoded_length;
+    for (size_t offset = 0; offset < encoded_length;) {
+        size_t n = encoded_length - offset;
+        if (n > step) n = step;
+        offset += kiss_decoder_push(&d, encoded + offset, n);
+    }
+    sink += d.packet.data_length;
+}
+
+static void measure(const char *name, void (*fn)(void), size_t size, int density, size_t chunk, double seconds) {
+    size_t iterations = 0;
+    size_t batch = 1;
+    double start = now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        for (size_t i = 0; i < batch; i++) fn();
+        iterations += batch;
+        if (batch < 65536) batch *= 2;
+        elapsed = now() - start;
+    }
+    printf("%s,%zu,%d,%zu,%zu,%.6f,%.2f,%.0f\n", name, size, density, chunk, iterations, elapsed,
+        (double) iterations * size / elapsed / 1e6, (double) iterations / elapsed);
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 0.05;
+
+    kiss_init();
+    printf("# scanner=%s\n", kiss_scan_implementation());
+    printf("function,size,escape_percent,chunk,iterations,seconds,mb_per_s,frames_per_s\n");
+    for (size_t s = 0; s < SIZE_COUNT; s++) {
+        for (size_t d = 0; d < DENSITY_COUNT; d++) {
+            fill_payload(SIZES[s], DENSITIES[d]);
+            measure("kiss_encode_data", run_encode_data, SIZES[s], DENSITIES[d], 0, seconds);
+            measure("kiss_decode_data", run_decode_data, SIZES[s], DENSITIES[d], 0, seconds);
+            measure("kiss_encode_packet", run_encode_packet, SIZES[s], DENSITIES[d], 0, seconds);
+            measure("kiss_decode_packet", run_decode_packet, SIZES[s], DENSITIES[d], 0, seconds);
+            for (size_t c = 0; c < CHUNK_COUNT; c++) {
+                chunk_size = CHUNKS[c];
+                measure("kiss_decoder_push", run_decoder_push, SIZES[s], DENSITIES[d], CHUNKS[c], seconds);
+            }
+        }
+    }
+    return 0;
+}
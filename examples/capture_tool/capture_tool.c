@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <kiss.h>
+#include <kiss_capture.h>
+#include <kiss_uring.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Records KISS traffic into an indexed capture file, and prints frames from one.
+ *
+ *   capture_tool record capture.kcap < packets.bin
+ *   capture_tool dump capture.kcap [from_ns [to_ns]]
+ *
+ * Recording appends to an existing capture, recovering it first if it was
+ * not closed properly. Dumping seeks straight to the first frame at or after
+ * from_ns instead of reading the file from the start.
+ */
+
+#if defined(__linux__)
+
+struct recorder {
+    kiss_uring_t ring;
+    kiss_capture_writer_t writer;
+    int error;
+};
+
+static void record_packet(const kiss_packet_t *packet, void *context) {
+    struct recorder *r = context;
+    if (kiss_uring_capture(&r->ring, &r->writer, kiss_capture_now(), packet) != 0) {
+        r->error = errno;
+        kiss_uring_stop(&r->ring);
+    }
+}
+
+static void record_closed(int fd, int error, void *context) {
+    struct recorder *r = context;
+    (void) fd;
+    if (error) r->error = error;
+}
+
+// Full blocks are written in the background while stdin is read
+static int record(const char *path) {
+    struct recorder r;
+    memset(&r, 0, sizeof(r));
+    if (kiss_capture_append(&r.writer, path, 0) != 0) {
+        perror(path);
+        return 1;
+    }
+    if (kiss_uring_init(&r.ring, 1024) != 0 || !kiss_uring_add(&r.ring, STDIN_FILENO, record_packet, record_closed, &r)) {
+        perror("kiss_uring");
+        return 1;
+    }
+    if (kiss_uring_run(&r.ring) != 0 && !r.error) r.error = errno;
+    if (kiss_uring_drain(&r.ring) != 0 && !r.error) r.error = EIO;
+    kiss_uring_free(&r.ring);
+    if (kiss_capture_close(&r.writer) != 0 && !r.error) r.error = errno;
+    if (r.error) {
+        fprintf(stderr, "%s: %s\n", path, strerror(r.error));
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+static int record(const char *path) {
+    kiss_capture_writer_t writer;
+    if (kiss_capture_append(&writer, path, 0) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    uint8_t buffer[4096];
+    uint8_t packet_buffer[1024];
+    kiss_decoder_t decoder = kiss_new_decoder(packet_buffer, sizeof(packet_buffer));
+    ssize_t bytes_read;
+    while ((bytes_read = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+        uint64_t now = kiss_capture_now();
+        size_t offset = 0;
+        while (offset < (size_t) bytes_read) {
+            offset += kiss_decoder_push(&decoder, buffer + offset, bytes_read - offset);
+            if (decoder.packet.complete_packet && kiss_capture_write(&writer, now, &decoder.packet) != 0) {
+                perror(path);
+                return 1;
+            }
+        }
+    }
+    if (bytes_read < 0 || kiss_capture_close(&writer) != 0) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
+
+static int dump(const char *path, uint64_t from, uint64_t to) {
+    kiss_capture_reader_t reader;
+    if (kiss_capture_open(&reader, path) != 0) {
+        perror(path);
+        return 1;
+    }
+    if (reader.recovered) fprintf(stderr, "%s was not closed properly, indexed %llu frames by scanning it\n", path, (unsigned long long) reader.frames);
+
+    uint64_t timestamp;
+    kiss_packet_t packet;
+    if (kiss_capture_seek(&reader, from) == 0) {
+        while (kiss_capture_next(&reader, &timestamp, &packet) && timestamp <= to) {
+            printf("%llu Port: %d, Command: %s, Data: ", (unsigned long long) timestamp, packet.port, kiss_command_name(packet.command));
+            for (size_t i = 0; i < packet.data_length; i++) {
+                uint8_t b = packet.data[i];
+                if (b >= 20 && b <= 126) {
+                    // Printable ASCII character
+                    printf("%c", b);
+                } else {
+                    // Non-printable character
+                    printf("<0x%02X>", b);
+                }
+            }
+            printf("\n");
+        }
+    }
+    kiss_capture_close_reader(&reader);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "record") == 0) return record(argv[2]);
+    if (argc >= 3 && strcmp(argv[1], "dump") == 0) {
+        uint64_t from = (argc > 3) ? strtoull(argv[3], 0, 10) : 0;
+        uint64_t to = (argc > 4) ? strtoull(argv[4], 0, 10) : UINT64_MAX;
+        return dump(argv[2], from, to);
+    }
+    fprintf(stderr, "Usage: %s record FILE < kiss_stream\n       %s dump FILE [FROM_NS [TO_NS]]\n", argv[0], argv[0]);
+    return 2;
+}
@@ -21,6 +21,7 @@ SOFTWARE.
 */
 
 #include <kiss.h>
+#include <kiss_stats.h>
 
 #include <unistd.h>
 #include <stdio.h>
@@ -31,16 +32,6 @@ SOFTWARE.
 
 extern int errno;
 
-/**
- * This is the number of bytes to drop when the buffer fills up and
- * we still haven't found a packet. Dropping a single byte gives us
- * the best chance to find a new packet, but it is also the most 
- * time consuming because in a worst case scenario we will shift 
- * the whole buffer on each read operation. We drop 32 bytes here,
- * but your results may vary.
-*/
-#define BYTES_TO_DROP 32
-
 int main(int argc, char *argv[]) {
     // Open our input file, or use STDIN if no file was provided
     int file = STDIN_FILENO;
@@ -55,55 +46,58 @@ int main(int argc, char *argv[]) {
 
     /**
      * Start with an empty buffer to hold incoming encoded data.
-          * 
-     * The buffer should be able to hold the largest message you expect to receive.
-     * The KISS standard suggests that this buffer not be artificially limited in size,
-     * but in reality the size depends on the underlying protocol.
      * 
-     * The AX.25 standard states that:
-     *      The default maximum number of octets allowed in the I field is 256. 
-     *      This variable is negotiable between end stations. 
+     * The streaming decoder keeps its own state between reads, so this
+     * buffer only needs to be big enough for an efficient read() call.
+     * Partial packets do not need to be kept in it.
      */
     size_t buffer_capacity = 1024;
-    size_t buffer_length = 0;
     uint8_t buffer[buffer_capacity];
 
     /** 
-     * We need another similar buffer to hold the decoded packet data.
-     * This buffer will be used internally by the packet, but we create it here so 
+     * We need another buffer to hold the decoded packet data.
+     * This buffer will be used internally by the decoder, but we create it here so 
      * that the library doesn't allocate any new memory.
+     * 
+     * The buffer should be able to hold the largest message you expect to receive.
+     * The KISS standard suggests that this buffer not be artificially limited in size,
+     * but in reality the size depends on the underlying protocol.
+     * 
+     * The AX.25 standard states that:
+     *      The default maximum number of octets allowed in the I field is 256. 
+     *      This variable is negotiable between end stations. 
      */
-    size_t packet_buffer_capacity = buffer_capacity;
+    size_t packet_buffer_capacity = 1024;
     uint8_t packet_buffer[packet_buffer_capacity];
 
-    // Create a packet data structure to hold the incoming packets
-    kiss_packet_t packet = kiss_new_packet(packet_buffer, packet_buffer_capacity);
+    // Create a streaming decoder to hold the incoming packets
+    kiss_decoder_t decoder = kiss_new_decoder(packet_buffer, packet_buffer_capacity);
+    kiss_packet_t *packet = &decoder.packet;
+
+    // Count what the decoder sees, so a misbehaving link shows up in the summary
+    kiss_stats_t stats;
+    kiss_stats_init(&stats, 0);
+    kiss_decoder_set_stats(&decoder, &stats);
 
     ssize_t bytes_read = 1;
     while (bytes_read > 0) {
-        // Fill remaining buffer
-        bytes_read = read(file, buffer + buffer_length, buffer_capacity - buffer_length);
+        bytes_read = read(file, buffer, buffer_capacity);
         if (bytes_read < 0 && errno != 0) {
             // An error occured
             perror(argv[0]);
             return 1;
         }
-        if (bytes_read > 0) {
-            // Increase the length of the buffer by the number of bytes we read
-            buffer_length += bytes_read;
-            // Try to parse a packet from what we have so far
-            size_t bytes_consumed = kiss_decode_packet(&packet, buffer, buffer_length);
-            if (bytes_consumed > 0) {
-                // Remove the consumed bytes
-                buffer_length -= bytes_consumed;
-                memcpy(buffer, buffer + bytes_consumed, buffer_length);
-            }
+
+        // Feed everything we read to the decoder, each byte is only looked at once
+        size_t offset = 0;
+        while (bytes_read > 0 && offset < (size_t) bytes_read) {
+            offset += kiss_decoder_push(&decoder, buffer + offset, bytes_read - offset);
 
             // Check for a complete packet, and print it to the console.
-            if (packet.complete_packet) {
-                printf("Port: %d, Command: %s, Data: ", packet.port, kiss_command_name(packet.command));
-                for (size_t i = 0; i < packet.data_length; i++) {
-                    uint8_t b = packet.data[i];
+            if (packet->complete_packet) {
+                printf("Port: %d, Command: %s, Data: ", packet->port, kiss_command_name(packet->command));
+                for (size_t i = 0; i < packet->data_length; i++) {
+                    uint8_t b = packet->data[i];
                     if (b >= 20 && b <= 126) {
                         // Printable ASCII character
                         printf("%c", b);
@@ -113,17 +107,14 @@ int main(int argc, char *argv[]) {
                     }
                 }
                 printf("\n");
-                // Reset packet for next use
-                kiss_clear_packet(&packet);
-            }
-
-            // If the buffer is full, we need to drop bytes to make room for new bytes.
-            if (buffer_length == buffer_capacity) {
-                buffer_length -= BYTES_TO_DROP;
-                memcpy(buffer, buffer + BYTES_TO_DROP, buffer_length);
             }
         }
     }
 
+    fprintf(stderr, "Frames: %zu, Bytes in: %zu, Bytes out: %zu, Escapes: %zu, Invalid escapes: %zu, "
+            "Truncated: %zu, Dropped bytes: %zu, Empty frames: %zu\n",
+            stats.frames, stats.bytes_in, stats.bytes_out, stats.escapes, stats.invalid_escapes,
+            stats.truncated, stats.dropped_bytes, stats.empty_frames);
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <kiss.hpp>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Decodes packets with the header-only C++ interface.
+ *
+ * Nothing from the C library is linked in, the decoder and the handler
+ * below are compiled into a single loop.
+ */
+int main(int argc, char *argv[]) {
+    // Open our input file, or use STDIN if no file was provided
+    int file = STDIN_FILENO;
+    if (argc > 1) {
+        file = open(argv[1], O_RDONLY);
+        if (file == -1) {
+            perror(argv[0]);
+            return 1;
+        }
+    }
+
+    // Storage for the largest packet we expect is part of the decoder itself
+    kiss::Decoder<1024> decoder;
+
+    // Frames are re-encoded as they arrive, to show the encoder working on a range
+    std::vector<uint8_t> encoded;
+    size_t frames = 0;
+
+    uint8_t buffer[1024];
+    ssize_t bytes_read;
+    while ((bytes_read = read(file, buffer, sizeof(buffer))) > 0) {
+        frames += decoder.push(kiss::span<const uint8_t>(buffer, bytes_read), [&](const kiss::Frame &frame) {
+            printf("Port: %d, Command: %s, Data: ", frame.port, kiss::command_name(frame.command));
+            for (uint8_t b : frame.data) {
+                if (b >= 20 && b <= 126) {
+                    // Printable ASCII character
+                    printf("%c", b);
+                } else {
+                    // Non-printable character
+                    printf("<0x%02X>", b);
+                }
+            }
+            printf("\n");
+            kiss::Encoder(frame.command, frame.port).encode(frame.data, std::back_inserter(encoded));
+        });
+    }
+    if (bytes_read < 0) {
+        perror(argv[0]);
+        return 1;
+    }
+
+    fprintf(stderr, "Frames: %zu, Re-encoded bytes: %zu, Truncated bytes: %zu\n",
+            frames, encoded.size(), decoder.truncated());
+    return 0;
+}
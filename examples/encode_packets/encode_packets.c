@@ -21,6 +21,7 @@ SOFTWARE.
 */
 
 #include <kiss.h>
+#include <kiss_tx.h>
 
 #include <unistd.h>
 #include <stdio.h>
@@ -31,6 +32,14 @@ SOFTWARE.
 
 extern int errno;
 
+// Write everything in the transmit queue, returns 0 on success
+static int flush_all(kiss_tx_t *tx) {
+    while (kiss_tx_length(tx) > 0) {
+        if (kiss_tx_flush(tx, STDOUT_FILENO, 0) < 0) return -1;
+    }
+    return 0;
+}
+
 // Encodes a single packet
 int main(int argc, char *argv[]) {
     // Open our input file, or use STDIN if no file was provided
@@ -46,9 +55,19 @@ int main(int argc, char *argv[]) {
 
     size_t buffer_capacity = 32;
     uint8_t buffer[buffer_capacity];
-    uint8_t output_buffer[buffer_capacity * 2];
     kiss_packet_t p = kiss_new_packet(buffer, buffer_capacity);
 
+    /**
+     * Packets are encoded into a transmit queue as they are read, and the
+     * queue is written with one writev() call whenever it fills up, so a
+     * large input takes a few big writes instead of one per packet. A short
+     * read means no more input is waiting, as with interactive or streaming
+     * input, so the queue is written then too instead of holding frames back.
+     */
+    uint8_t queue_buffer[65536];
+    kiss_tx_t tx;
+    kiss_tx_init(&tx, queue_buffer, sizeof(queue_buffer));
+
     ssize_t bytes_read = 1;
     while (bytes_read > 0) {
         bytes_read = read(file, buffer, buffer_capacity);
@@ -59,8 +78,16 @@ int main(int argc, char *argv[]) {
         }
         if (bytes_read > 0) {
             p.data_length = bytes_read;
-            size_t bytes_written = kiss_encode_packet(p, output_buffer, buffer_capacity * 2);
-            write(STDOUT_FILENO, output_buffer, bytes_written);
+            while (kiss_tx_queue(&tx, &p) != 0) {
+                if (kiss_tx_flush(&tx, STDOUT_FILENO, 0) < 0) {
+                    perror(argv[0]);
+                    return 1;
+                }
+            }
+        }
+        if ((size_t) bytes_read < buffer_capacity && flush_all(&tx) < 0) {
+            perror(argv[0]);
+            return 1;
         }
     }
 
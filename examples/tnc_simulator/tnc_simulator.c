@@ -0,0 +1,277 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+
+#include <kiss.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+extern int errno;
+
+/**
+ * A stand-in TNC for load testing.
+ *
+ * It either generates synthetic KISS traffic or replays a raw KISS capture,
+ * and writes it to stdout, to a pseudo-terminal, or to a TCP client.
+ *
+ * Generated traffic picks a port, command and frame size at random for each
+ * frame, and can be sent in bursts of back-to-back frames. Replayed frames
+ * are paced as they would arrive over a serial line at the given baud rate,
+ * and the scale option speeds that up or slows it down.
+ */
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [options] [capture file]\n"
+        "  -n count      Frames to send, 0 for no limit (default 1000, or all of a capture)\n"
+        "  -p ports      Comma separated ports to use (default 0)\n"
+        "  -c commands   Comma separated commands to use (default 0)\n"
+        "  -m min        Smallest frame data size (default 16)\n"
+        "  -M max        Largest frame data size (default 256)\n"
+        "  -e percent    Percent of data bytes that need escaping (default 1)\n"
+        "  -r rate       Frames per second, 0 for no limit (default 0)\n"
+        "  -B burst      Frames sent back to back in each burst (default 1)\n"
+        "  -b baud       Pace output like a serial line at this baud rate (default none)\n"
+        "  -s scale      Speed up timing by this factor (default 1.0)\n"
+        "  -P            Serve on a new pseudo-terminal\n"
+        "  -t port       Serve on a local TCP port\n"
+        "With a capture file the frames in it are replayed instead of generated.\n",
+        name);
+}
+
+// Parse a comma separated list of small numbers
+static size_t parse_list(const char *s, uint8_t *values, size_t capacity) {
+    size_t count = 0;
+    while (*s && count < capacity) {
+        values[count++] = (uint8_t) strtoul(s, (char **) &s, 0);
+        if (*s == ',') s++;
+    }
+    return count;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void sleep_until(double when) {
+    double delay = when - now();
+    if (delay <= 0) return;
+    struct timespec t = {(time_t) delay, (long) ((delay - (time_t) delay) * 1e9)};
+    nanosleep(&t, 0);
+}
+
+static int write_all(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+// Create a pseudo-terminal in raw mode and print the name of its slave side
+static int open_pty(void) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return -1;
+    const char *name = ptsname(master);
+    // Keep the slave open so writes do not fail before a reader connects
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0) return -1;
+    struct termios t;
+    tcgetattr(slave, &t);
+    cfmakeraw(&t);
+    tcsetattr(slave, TCSANOW, &t);
+    fprintf(stderr, "Serving on %s\n", name);
+    return master;
+}
+
+// Wait for a single client on a local TCP port
+static int accept_tcp(int port) {
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) return -1;
+    int on = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(server, 1) != 0) {
+        close(server);
+        return -1;
+    }
+    fprintf(stderr, "Waiting for a client on 127.0.0.1:%d\n", port);
+    int client = accept(server, 0, 0);
+    close(server);
+    return client;
+}
+
+// Fill a frame with random data, escape_percent of it FEND or FESC
+static void random_data(uint8_t *data, size_t length, int escape_percent) {
+    for (size_t i = 0; i < length; i++) {
+        if (rand() % 100 < escape_percent) {
+            data[i] = (rand() & 1) ? KISS_FRAME_END : KISS_FRAME_ESCAPE;
+        } else {
+            data[i] = (uint8_t) (' ' + rand() % 95);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = 1000;
+    int count_set = 0;
+    uint8_t ports[16] = {0};
+    size_t port_count = 1;
+    uint8_t commands[16] = {KISS_DATA_FRAME};
+    size_t command_count = 1;
+    size_t min_size = 16;
+    size_t max_size = 256;
+    int escape_percent = 1;
+    double rate = 0;
+    size_t burst = 1;
+    double baud = 0;
+    double scale = 1.0;
+    int use_pty = 0;
+    int tcp_port = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:c:m:M:e:r:B:b:s:Pt:h")) != -1) {
+        switch (opt) {
+            case 'n': count = strtoul(optarg, 0, 0); count_set = 1; break;
+            case 'p': port_count = parse_list(optarg, ports, 16); break;
+            case 'c': command_count = parse_list(optarg, commands, 16); break;
+            case 'm': min_size = strtoul(optarg, 0, 0); break;
+            case 'M': max_size = strtoul(optarg, 0, 0); break;
+            case 'e': escape_percent = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'B': burst = strtoul(optarg, 0, 0); break;
+            case 'b': baud = atof(optarg); break;
+            case 's': scale = atof(optarg); break;
+            case 'P': use_pty = 1; break;
+            case 't': tcp_port = atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (port_count == 0 || command_count == 0 || max_size < min_size || burst == 0 || scale <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Load the capture to replay, if any
+    uint8_t *capture = 0;
+    size_t capture_length = 0;
+    if (optind < argc) {
+        FILE *f = fopen(argv[optind], "rb");
+        if (!f) {
+            perror(argv[optind]);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        capture_length = (size_t) ftell(f);
+        fseek(f, 0, SEEK_SET);
+        capture = malloc(capture_length ? capture_length : 1);
+        if (!capture || fread(capture, 1, capture_length, f) != capture_length) {
+            perror(argv[optind]);
+            return 1;
+        }
+        fclose(f);
+        // Replay the whole capture unless told otherwise
+        if (!count_set) count = 0;
+    }
+
+    int out = STDOUT_FILENO;
+    if (use_pty) {
+        out = open_pty();
+    } else if (tcp_port) {
+        out = accept_tcp(tcp_port);
+    }
+    if (out < 0) {
+        perror(argv[0]);
+        return 1;
+    }
+
+    uint8_t data[65536];
+    uint8_t encoded[sizeof(data) * 2 + 4];
+    kiss_packet_t p = kiss_new_packet(data, sizeof(data));
+    kiss_frame_t frame;
+    size_t offset = 0;
+    size_t sent = 0;
+    srand((unsigned int) time(0));
+    double next = now();
+
+    while (count == 0 || sent < count) {
+        if (capture) {
+            // Next frame from the capture, decoded and encoded again as a real TNC would
+            size_t resume = 0;
+            if (kiss_decode_packets(capture + offset, capture_length - offset, &frame, 1, &resume) == 0 || !frame.complete_frame) break;
+            p.command = frame.command;
+            p.port = frame.port;
+            p.data_length = kiss_decode_data(capture + offset + frame.offset, frame.encoded_length, data, sizeof(data));
+            offset += frame.offset + frame.encoded_length;
+        } else {
+            p.command = (kiss_command_t) commands[rand() % command_count];
+            p.port = ports[rand() % port_count];
+            p.data_length = min_size + (size_t) rand() % (max_size - min_size + 1);
+            if (p.data_length > sizeof(data)) p.data_length = sizeof(data);
+            random_data(data, p.data_length, escape_percent);
+        }
+
+        size_t length = kiss_encode_packet(p, encoded, sizeof(encoded));
+        if (write_all(out, encoded, length) != 0) {
+            perror(argv[0]);
+            return 1;
+        }
+        sent++;
+
+        // Pace the output
+        if (baud > 0) {
+            // 8 data bits plus start and stop bits
+            next += length * 10.0 / baud / scale;
+            sleep_until(next);
+        }
+        if (rate > 0 && sent % burst == 0) {
+            next += burst / rate / scale;
+            sleep_until(next);
+        }
+    }
+
+    fprintf(stderr, "Sent %zu frames\n", sent);
+    free(capture);
+    return 0;
+}
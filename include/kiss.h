@@ -30,6 +30,16 @@ SOFTWARE.
 #define KISS_ESCAPE_FEND    0xDC
 #define KISS_ESCAPE_FESC    0xDD
 
+#define KISS_PORTS          16
+#define KISS_COMMANDS       16
+
+// Data written by different threads is kept this many bytes apart
+#define KISS_CACHE_LINE     64
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -58,12 +68,106 @@ struct kiss_packet {
 };
 typedef struct kiss_packet kiss_packet_t;
 
+// A buffer reference for scatter/gather output, the same as struct iovec where available
+#if defined(__unix__) || defined(__APPLE__)
+typedef struct iovec kiss_iovec_t;
+#else
+struct kiss_iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+typedef struct kiss_iovec kiss_iovec_t;
+#endif
+
+// Describes a frame found by kiss_decode_packets
+struct kiss_frame {
+    kiss_command_t command;
+    uint8_t port;
+    uint8_t complete_frame;
+    size_t offset;          // Offset of the first encoded data byte in the buffer
+    size_t encoded_length;  // Length of the encoded data
+    size_t data_length;     // Length of the data once decoded
+    uint8_t decoded;        // Set by kiss_frame_data once the data has been decoded in place
+};
+typedef struct kiss_frame kiss_frame_t;
+
+enum kiss_decoder_state {
+    KISS_DECODER_IDLE = 0,      // Waiting for the start of a frame
+    KISS_DECODER_COMMAND = 1,   // Seen FEND, next byte is the command
+    KISS_DECODER_DATA = 2,      // Reading frame data
+    KISS_DECODER_ESCAPE = 3,    // Seen FESC, next byte is escaped
+    KISS_DECODER_SKIP = 4,      // Skipping a frame rejected by the filter
+    KISS_DECODER_COMMAND_ESCAPE = 5,    // Seen FESC in place of the command byte
+};
+
+typedef enum kiss_decoder_state kiss_decoder_state_t;
+
+enum kiss_fragment_status {
+    KISS_FRAGMENT_OK = 0,           // The frame ended normally
+    KISS_FRAGMENT_BAD_CRC = 1,      // The frame failed its SMACK or FlexNet CRC check, discard it
+};
+typedef enum kiss_fragment_status kiss_fragment_status_t;
+
+// A piece of a frame too big for the decoder buffer, see kiss_decoder_set_fragments
+struct kiss_fragment {
+    kiss_command_t command;
+    uint8_t port;
+    uint8_t end;                    // Set on the last piece of a frame
+    kiss_fragment_status_t status;  // Set on the last piece
+    const uint8_t *data;            // Decoded data, valid only during the call
+    size_t length;
+    size_t offset;                  // Where this piece starts in the frame
+    size_t total;                   // On the last piece, the length of the whole frame
+};
+typedef struct kiss_fragment kiss_fragment_t;
+
+typedef void (*kiss_fragment_handler_t)(const kiss_fragment_t *fragment, void *context);
+
+struct kiss_stats;
+struct kiss_ax25_filter;
+struct kiss_crc_link;
+
+// A streaming decoder that keeps its state between calls
+struct kiss_decoder {
+    kiss_packet_t packet;
+    kiss_decoder_state_t state;
+    const uint16_t *filter;     // Optional, per port bit mask of commands to accept
+    struct kiss_stats *stats;   // Optional, counters updated while decoding
+    const struct kiss_ax25_filter *ax25;    // Optional, AX.25 address filter for data frames
+    uint8_t header_checked;     // The current frame has passed the AX.25 filter
+    struct kiss_crc_link *crc;  // Optional, SMACK or FlexNet CRC checking, see kiss_crc.h
+    uint8_t crc_type;           // The kind of CRC on the current frame
+    uint16_t crc_value;         // The CRC of the current frame so far
+    kiss_fragment_handler_t fragments;  // Optional, receives frames too big for the packet buffer
+    void *fragments_context;
+    size_t fragment_offset;     // Bytes of the current frame already handed to fragments
+};
+typedef struct kiss_decoder kiss_decoder_t;
+
+// A FEND/FESC scanner, see kiss_find_special
+typedef size_t (*kiss_scan_fn_t)(const uint8_t *buffer, size_t buffer_size);
+
+// Select the fastest implementation for this CPU, optional
+void kiss_init(void);
+
+// Return the name of the FEND/FESC scanner in use
+const char* kiss_scan_implementation(void);
+
+// Return the index of the first FEND or FESC byte, or buffer_size if there is none
+size_t kiss_find_special(const uint8_t *buffer, size_t buffer_size);
+
+// Return the scanner called name ("swar", "sse2", "avx2" or "neon"), or 0 if it is not built in or this CPU lacks it
+kiss_scan_fn_t kiss_scan_get(const char *name);
+
 // Encode packet data
 size_t kiss_encode_data(uint8_t *decoded, size_t decoded_length, uint8_t *encoded, size_t encoded_length);
 
 // Decode packet data
 size_t kiss_decode_data(uint8_t *encoded, size_t data_length, uint8_t *buffer, size_t buffer_length);
 
+// Decode packet data within the same buffer, returns the decoded length
+size_t kiss_decode_data_in_place(uint8_t *data, size_t data_length);
+
 // Encode the command and port in a single byte
 uint8_t kiss_encode_command(kiss_command_t command, uint8_t port);
 
@@ -73,15 +177,70 @@ void kiss_decode_command(uint8_t b, kiss_command_t *command, uint8_t *port);
 // Encode a packet, returns bytes written to buffer
 size_t kiss_encode_packet(kiss_packet_t p, uint8_t *buffer, size_t buffer_size);
 
+// Return the number of bytes data will take once escaped
+size_t kiss_escaped_length(const uint8_t *data, size_t data_length);
+
+// Return the number of bytes a packet will take once encoded, including an escaped command byte
+size_t kiss_encoded_length(const kiss_packet_t *packet);
+
+// Encode a packet as a list of buffers that reference the packet data instead of copying it.
+// header must hold 3 bytes, for an escaped command byte, and stay valid until the buffers are written.
+// Returns the number of iovec entries used, or 0 if iov_count is too small.
+size_t kiss_encode_packet_iov(const kiss_packet_t *packet, uint8_t *header, kiss_iovec_t *iov, size_t iov_count);
+
 // Decode a packet, returns bytes consumed from buffer
 size_t kiss_decode_packet(kiss_packet_t *packet, uint8_t *buffer, size_t buffer_size);
 
+// Find all frames in a buffer in one pass, returns the number of frames found.
+// A trailing partial frame is included with complete_frame set to 0.
+// resume is set to the offset where the next call should start.
+size_t kiss_decode_packets(const uint8_t *buffer, size_t buffer_size, kiss_frame_t *frames, size_t frames_capacity, size_t *resume);
+
+// Return the decoded data of a frame found by kiss_decode_packets.
+// Frames without escapes point straight into the buffer, others are decoded in place,
+// which overwrites the encoded bytes and marks the frame decoded so later calls do not decode it again.
+uint8_t* kiss_frame_data(uint8_t *buffer, kiss_frame_t *frame);
+
+// Decode a packet without copying, returns bytes consumed from buffer.
+// The packet data will point into the buffer, which may be modified.
+size_t kiss_decode_packet_in_place(kiss_packet_t *packet, uint8_t *buffer, size_t buffer_size);
+
 // Create and initialize a packet
 kiss_packet_t kiss_new_packet(uint8_t *data_buffer, size_t data_buffer_size);
 
 // Re-initialize a packet
 void kiss_clear_packet(kiss_packet_t *packet);
 
+// Create and initialize a streaming decoder
+kiss_decoder_t kiss_new_decoder(uint8_t *data_buffer, size_t data_buffer_size);
+
+// Only decode frames whose command bit is set in filter[port], frames are skipped otherwise.
+// filter must have 16 entries, or be 0 to accept everything.
+void kiss_decoder_set_filter(kiss_decoder_t *decoder, const uint16_t *filter);
+
+// Drop data frames by AX.25 address before their payload is copied, see kiss_ax25.h. Pass 0 to keep everything.
+void kiss_decoder_set_ax25_filter(kiss_decoder_t *decoder, const struct kiss_ax25_filter *filter);
+
+// Check and remove SMACK or FlexNet CRCs, see kiss_crc.h. Pass 0 to stop.
+void kiss_decoder_set_crc(kiss_decoder_t *decoder, struct kiss_crc_link *link);
+
+// Hand frames too big for the packet buffer to handler a buffer full at a time instead of
+// truncating them. Frames that fit are still returned as packets. Pass 0 to stop.
+void kiss_decoder_set_fragments(kiss_decoder_t *decoder, kiss_fragment_handler_t handler, void *context);
+
+// Count what the decoder sees in stats, see kiss_stats.h. Pass 0 to stop counting.
+void kiss_decoder_set_stats(kiss_decoder_t *decoder, struct kiss_stats *stats);
+
+// Re-initialize a streaming decoder, discarding any partial packet
+void kiss_clear_decoder(kiss_decoder_t *decoder);
+
+// Feed bytes to a streaming decoder, returns bytes consumed from buffer.
+// Stops after the end of a packet, check decoder->packet.complete_packet.
+size_t kiss_decoder_push(kiss_decoder_t *decoder, const uint8_t *buffer, size_t buffer_size);
+
+// Feed a single byte to a streaming decoder, returns 1 if a packet was completed
+uint8_t kiss_decoder_push_byte(kiss_decoder_t *decoder, uint8_t b);
+
 // Return a human readable name for a command
 const char* kiss_command_name(kiss_command_t command);
 
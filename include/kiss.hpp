@@ -0,0 +1,318 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+/**
+ * Header-only C++ interface.
+ *
+ * Everything here is inline, so a decoder and the handler given to it are
+ * compiled together and the per-frame dispatch can be inlined into the
+ * decoding loop. Nothing needs to be linked from the C library.
+ *
+ * Decoder storage is sized at compile time with the Capacity parameter, so
+ * a decoder can live on the stack or inside another object without any
+ * allocation. Byte buffers are passed as spans, std::span with C++20 and a
+ * small equivalent with C++17.
+ */
+
+#include "kiss.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+namespace kiss {
+
+constexpr uint8_t frame_end = KISS_FRAME_END;
+constexpr uint8_t frame_escape = KISS_FRAME_ESCAPE;
+constexpr uint8_t escape_fend = KISS_ESCAPE_FEND;
+constexpr uint8_t escape_fesc = KISS_ESCAPE_FESC;
+
+#if defined(__cpp_lib_span)
+template <class T>
+using span = std::span<T>;
+#else
+// A pointer and a length, for C++17 where std::span is not available
+template <class T>
+class span {
+public:
+    constexpr span() noexcept : data_(nullptr), size_(0) {}
+    constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+    template <std::size_t N>
+    constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+    template <class Container, class = decltype(std::declval<Container &>().data())>
+    constexpr span(Container &container) noexcept : data_(container.data()), size_(container.size()) {}
+    template <class U, class = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U> &other) noexcept : data_(other.data()), size_(other.size()) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+    constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+    constexpr span first(std::size_t n) const noexcept { return span(data_, n); }
+    constexpr span subspan(std::size_t offset) const noexcept { return span(data_ + offset, size_ - offset); }
+
+private:
+    T *data_;
+    std::size_t size_;
+};
+#endif
+
+// Encode the command and port in a single byte
+constexpr uint8_t encode_command(kiss_command_t command, uint8_t port) noexcept {
+    return static_cast<uint8_t>((port << 4) | command);
+}
+
+// Decode the command from a command byte
+constexpr kiss_command_t command_of(uint8_t b) noexcept {
+    return static_cast<kiss_command_t>(b & 0x0f);
+}
+
+// Decode the port from a command byte
+constexpr uint8_t port_of(uint8_t b) noexcept {
+    return static_cast<uint8_t>((b >> 4) & 0x0f);
+}
+
+// Return a human readable name for a command
+constexpr const char *command_name(kiss_command_t command) noexcept {
+    switch (command) {
+        case KISS_DATA_FRAME: return "Data Frame";
+        case KISS_TX_DELAY: return "TX Delay";
+        case KISS_PERSISTENCE: return "Persistence";
+        case KISS_SLOT_TIME: return "Slot Time";
+        case KISS_TX_TAIL: return "TX Tail";
+        case KISS_FULL_DUPLEX: return "Full Duplex";
+        case KISS_SET_HARDWARE: return "Set Hardware";
+        case KISS_RETURN: return "Exit KISS Mode";
+        default: return "Unknown";
+    }
+}
+
+// A decoded frame, data points into the decoder and is valid until the next push
+struct Frame {
+    kiss_command_t command;
+    uint8_t port;
+    span<const uint8_t> data;
+};
+
+// Return the number of bytes data will take once escaped
+template <class Range>
+constexpr std::size_t encoded_data_length(const Range &data) noexcept {
+    std::size_t len = 0;
+    for (uint8_t b : data) len += (b == frame_end || b == frame_escape) ? 2 : 1;
+    return len;
+}
+
+// Decode escaped data like kiss_decode_data, returns the decoded length or encoded.size() + 1 if out is too small
+inline std::size_t decode_data(span<const uint8_t> encoded, span<uint8_t> out) noexcept {
+    std::size_t len = 0;
+    std::size_t i = 0;
+    while (i < encoded.size()) {
+        uint8_t b = encoded[i++];
+        if (b == frame_escape) {
+            // Repeated escapes are skipped, and one at the end is dropped
+            while (i < encoded.size() && encoded[i] == frame_escape) i++;
+            if (i == encoded.size()) break;
+            b = encoded[i++];
+            if (b == escape_fend) b = frame_end;
+            else if (b == escape_fesc) b = frame_escape;
+        }
+        if (len == out.size()) return encoded.size() + 1;
+        out[len++] = b;
+    }
+    return len;
+}
+
+/**
+ * Encodes frames for one port and command from any range of bytes.
+ *
+ * The output is written through an iterator, so frames can go straight into
+ * a std::vector with std::back_inserter, into a fixed buffer, or anywhere
+ * else that accepts bytes.
+ */
+class Encoder {
+public:
+    constexpr Encoder(kiss_command_t command = KISS_DATA_FRAME, uint8_t port = 0) noexcept
+        : command_byte_(encode_command(command, port)) {}
+
+    // Return the number of bytes a frame holding data will take, the command byte is escaped on port 12
+    template <class Range>
+    constexpr std::size_t encoded_length(const Range &data) const noexcept {
+        return encoded_data_length(data) + (special(command_byte_) ? 4 : 3);
+    }
+
+    // Write a whole frame, returns the iterator past the last byte written
+    template <class Range, class OutputIt>
+    constexpr OutputIt encode(const Range &data, OutputIt out) const {
+        *out++ = frame_end;
+        out = put(command_byte_, out);
+        for (uint8_t b : data) out = put(b, out);
+        *out++ = frame_end;
+        return out;
+    }
+
+    // Write a whole frame into a buffer, returns the bytes written or 0 if it does not fit
+    inline std::size_t encode_into(span<const uint8_t> data, span<uint8_t> out) const noexcept {
+        if (out.size() < data.size() + 3) return 0;
+        if (out.size() < data.size() * 2 + 4 && out.size() < encoded_length(data)) return 0;
+        return static_cast<std::size_t>(encode(data, out.data()) - out.data());
+    }
+
+    constexpr uint8_t command_byte() const noexcept { return command_byte_; }
+
+private:
+    static constexpr bool special(uint8_t b) noexcept {
+        return b == frame_end || b == frame_escape;
+    }
+
+    // Write one byte, escaped if it has to be
+    template <class OutputIt>
+    static constexpr OutputIt put(uint8_t b, OutputIt out) {
+        if (b == frame_end) {
+            *out++ = frame_escape;
+            *out++ = escape_fend;
+        } else if (b == frame_escape) {
+            *out++ = frame_escape;
+            *out++ = escape_fesc;
+        } else {
+            *out++ = b;
+        }
+        return out;
+    }
+
+    uint8_t command_byte_;
+};
+
+/**
+ * A streaming decoder with Capacity bytes of frame storage.
+ *
+ * push() decodes everything it is given and calls the handler for each
+ * complete frame. The handler is a template parameter, so a lambda or
+ * function object is inlined into the loop. Frames longer than Capacity
+ * are truncated, and the number of dropped bytes is kept in truncated().
+ */
+template <std::size_t Capacity>
+class Decoder {
+    static_assert(Capacity > 0, "Decoder capacity must not be zero");
+
+public:
+    // Decode bytes and call handler(const Frame &) for each complete frame, returns the frame count
+    template <class Handler>
+    std::size_t push(span<const uint8_t> input, Handler &&handler) {
+        const uint8_t *in = input.data();
+        const std::size_t n = input.size();
+        std::size_t frames = 0;
+        std::size_t i = 0;
+
+        while (i < n) {
+            uint8_t b = in[i++];
+            if (b == frame_end) {
+                if (state_ == State::data || state_ == State::escape) {
+                    handler(Frame{command_of(command_), port_of(command_), span<const uint8_t>(data_, length_)});
+                    frames++;
+                }
+                state_ = State::command;
+                length_ = 0;
+                continue;
+            }
+            switch (state_) {
+                case State::idle: {
+                    // Not in a frame, skip ahead to the next FEND
+                    const void *next = std::memchr(in + i, frame_end, n - i);
+                    i = next ? static_cast<std::size_t>(static_cast<const uint8_t *>(next) - in) : n;
+                    continue;
+                }
+                case State::command:
+                    // Data frames on port 12 have a command byte of FEND, so it arrives escaped
+                    if (b == frame_escape) {
+                        state_ = State::command_escape;
+                        continue;
+                    }
+                    command_ = b;
+                    state_ = State::data;
+                    continue;
+                case State::command_escape:
+                    if (b == escape_fend) b = frame_end;
+                    else if (b == escape_fesc) b = frame_escape;
+                    command_ = b;
+                    state_ = State::data;
+                    continue;
+                case State::escape:
+                    if (b == escape_fend) b = frame_end;
+                    else if (b == escape_fesc) b = frame_escape;
+                    else if (b == frame_escape) continue;
+                    state_ = State::data;
+                    append(b);
+                    continue;
+                case State::data:
+                    if (b == frame_escape) {
+                        state_ = State::escape;
+                        continue;
+                    }
+                    // Copy the run of plain bytes without going back through the switch
+                    append(b);
+                    while (i < n && in[i] != frame_end && in[i] != frame_escape) append(in[i++]);
+                    continue;
+            }
+        }
+        return frames;
+    }
+
+    // Discard any partial frame
+    void clear() noexcept {
+        state_ = State::idle;
+        length_ = 0;
+    }
+
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+    // Data bytes dropped from frames longer than Capacity
+    std::size_t truncated() const noexcept { return truncated_; }
+
+private:
+    enum class State : uint8_t { idle, command, command_escape, data, escape };
+
+    void append(uint8_t b) noexcept {
+        if (length_ < Capacity) {
+            data_[length_++] = b;
+        } else {
+            truncated_++;
+        }
+    }
+
+    uint8_t data_[Capacity];
+    std::size_t length_ = 0;
+    std::size_t truncated_ = 0;
+    State state_ = State::idle;
+    uint8_t command_ = 0;
+};
+
+} // namespace kiss
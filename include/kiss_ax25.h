@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+// Bytes in one AX.25 address: six shifted callsign characters and an SSID byte
+#define KISS_AX25_ADDRESS_SIZE      7
+
+// Destination, source and up to eight digipeaters
+#define KISS_AX25_MAX_ADDRESSES     10
+#define KISS_AX25_MAX_HEADER        (KISS_AX25_ADDRESS_SIZE * KISS_AX25_MAX_ADDRESSES)
+
+// Callsigns a filter can hold, a power of two kept at most half full
+#define KISS_AX25_FILTER_SLOTS      256
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Which addresses of a frame a filter entry applies to
+enum kiss_ax25_field {
+    KISS_AX25_DESTINATION = 1,
+    KISS_AX25_SOURCE = 2,
+    KISS_AX25_DIGIPEATER = 4,
+    KISS_AX25_ANY = 7,
+};
+typedef enum kiss_ax25_field kiss_ax25_field_t;
+
+// What a filter does with frames that match it
+enum kiss_ax25_mode {
+    KISS_AX25_ACCEPT = 0,       // Only keep frames with a matching address
+    KISS_AX25_REJECT = 1,       // Drop frames with a matching address
+};
+typedef enum kiss_ax25_mode kiss_ax25_mode_t;
+
+// A callsign in its on-air form, with the SSIDs accepted in each address field
+struct kiss_ax25_filter_entry {
+    uint8_t callsign[6];
+    uint8_t used;
+    uint16_t ssids[3];          // Bit n set to match SSID n as destination, source or digipeater
+};
+typedef struct kiss_ax25_filter_entry kiss_ax25_filter_entry_t;
+
+/**
+ * A set of callsigns checked against the AX.25 address field of data frames.
+ *
+ * The callsigns are stored shifted, the way they appear on the air, in an
+ * open addressing hash table, so an address is matched without converting
+ * it first. A streaming decoder given a filter with
+ * kiss_decoder_set_ax25_filter checks each data frame as soon as enough of
+ * the address field has arrived, and skips the rest of a rejected frame
+ * without unescaping or copying it. Frames other than data frames are never
+ * filtered.
+ *
+ * A data frame too short to hold an address field is not AX.25, and only
+ * passes a KISS_AX25_REJECT filter.
+ */
+struct kiss_ax25_filter {
+    kiss_ax25_filter_entry_t slots[KISS_AX25_FILTER_SLOTS];
+    size_t count;
+    kiss_ax25_mode_t mode;
+};
+typedef struct kiss_ax25_filter kiss_ax25_filter_t;
+
+// Initialize an empty filter
+void kiss_ax25_filter_init(kiss_ax25_filter_t *filter, kiss_ax25_mode_t mode);
+
+// Add a callsign such as "N0CALL", "N0CALL-7" or "N0CALL-*" for any SSID. No SSID means SSID 0.
+// fields is a combination of kiss_ax25_field_t values. Returns 0 on success.
+int kiss_ax25_filter_add(kiss_ax25_filter_t *filter, const char *callsign, uint8_t fields);
+
+// Check the start of a data frame, returns 1 to keep it, 0 to drop it, or -1 if more of the address field is needed.
+// complete is non-zero when no more bytes of the frame will arrive.
+int kiss_ax25_filter_check(const kiss_ax25_filter_t *filter, const uint8_t *data, size_t length, uint8_t complete);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#define KISS_CAPTURE_MAGIC          "KISSCAP1"
+#define KISS_CAPTURE_BLOCK_MAGIC    0x4B424C4B  // "KBLK"
+#define KISS_CAPTURE_FOOTER_MAGIC   0x4B454E44  // "KEND"
+#define KISS_CAPTURE_VERSION        1
+
+// Sizes of the fixed parts of the file, all fields are little endian
+#define KISS_CAPTURE_HEADER_SIZE        16  // magic, version, block size
+#define KISS_CAPTURE_BLOCK_HEADER_SIZE  32  // magic, records, first time, last time, length, checksum
+#define KISS_CAPTURE_RECORD_HEADER_SIZE 16  // time, length, command, port, reserved
+#define KISS_CAPTURE_INDEX_ENTRY_SIZE   32  // first time, last time, offset, records, length
+#define KISS_CAPTURE_FOOTER_SIZE        32  // index offset, index entries, frames, magic, checksum
+
+// The default amount of frame data per block
+#define KISS_CAPTURE_BLOCK_SIZE     65536
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Where a block is and what time it covers
+struct kiss_capture_index_entry {
+    uint64_t first_time;
+    uint64_t last_time;
+    uint64_t offset;            // File offset of the block header
+    uint32_t records;
+    uint32_t length;            // Bytes of records after the block header
+};
+typedef struct kiss_capture_index_entry kiss_capture_index_entry_t;
+
+/**
+ * Captures decoded frames with their arrival time.
+ *
+ * Frames are collected into blocks, and each block is written with a single
+ * write() once it is full, with a checksum over its records. Closing the
+ * writer adds an index with the time range and offset of every block, and a
+ * fixed size footer that points at the index.
+ *
+ * A file that was never closed, for example after a crash, has no footer.
+ * Readers rebuild the index by walking the blocks, and opening it to append
+ * cuts off a partly written last block before carrying on.
+ *
+ * Timestamps are 64 bit values in any unit, nanoseconds from
+ * kiss_capture_now() by default. They are kept in non-decreasing order, a
+ * time earlier than the previous frame is recorded as the previous time.
+ */
+struct kiss_capture_writer {
+    int fd;
+    uint8_t *block;
+    size_t block_size;
+    size_t block_capacity;
+    size_t block_length;
+    uint32_t block_records;
+    uint64_t block_first;
+    uint64_t last_time;
+    uint64_t offset;            // Where the next block goes
+    uint64_t frames;
+    kiss_capture_index_entry_t *index;
+    size_t index_count;
+    size_t index_capacity;
+    uint8_t *spare;             // A block buffer given back by kiss_capture_return_block
+};
+typedef struct kiss_capture_writer kiss_capture_writer_t;
+
+/**
+ * Reads a capture file through mmap.
+ *
+ * Records are returned as packets that point into the mapping, so replaying
+ * a file does not copy frame data. kiss_capture_seek finds the block for a
+ * time with a binary search of the index and only scans inside that block.
+ */
+struct kiss_capture_reader {
+    uint8_t *map;
+    size_t size;
+    kiss_capture_index_entry_t *index;
+    size_t index_count;
+    size_t block;               // Index entry of the block being read
+    size_t position;            // File offset of the next record
+    size_t block_end;
+    uint64_t frames;
+    uint8_t recovered;          // The file had no footer and was indexed by scanning it
+};
+typedef struct kiss_capture_reader kiss_capture_reader_t;
+
+// Return the current time in nanoseconds since the epoch
+uint64_t kiss_capture_now(void);
+
+// Create a new capture file, replacing any existing one. block_size 0 uses the default. Returns 0 on success.
+int kiss_capture_create(kiss_capture_writer_t *writer, const char *path, size_t block_size);
+
+// Open a capture file to add to it, creating it if needed and recovering a truncated tail. Returns 0 on success.
+int kiss_capture_append(kiss_capture_writer_t *writer, const char *path, size_t block_size);
+
+// Record a frame, returns 0 on success
+int kiss_capture_write(kiss_capture_writer_t *writer, uint64_t timestamp, const kiss_packet_t *packet);
+
+// Write out the current block so it survives a crash, returns 0 on success
+int kiss_capture_flush(kiss_capture_writer_t *writer);
+
+// Finish the current block and hand it over to be written by the caller, for asynchronous I/O.
+// Returns 1 with the block, its length and its index entry, which holds its file offset, 0 if the block is empty, or -1 on error.
+// The block must be written before kiss_capture_close, then given back with kiss_capture_return_block.
+// It is not in the index, or counted in the footer, until it is added with kiss_capture_add_block.
+int kiss_capture_take_block(kiss_capture_writer_t *writer, uint8_t **block, size_t *length, kiss_capture_index_entry_t *entry);
+
+// Add a block from kiss_capture_take_block to the index once it has been written, returns 0 on success
+int kiss_capture_add_block(kiss_capture_writer_t *writer, const kiss_capture_index_entry_t *entry);
+
+// Give back a block from kiss_capture_take_block once it has been written, or has failed to be
+void kiss_capture_return_block(kiss_capture_writer_t *writer, uint8_t *block);
+
+// Write out the current block, the index and the footer, and close the file. Returns 0 on success.
+int kiss_capture_close(kiss_capture_writer_t *writer);
+
+// Map a capture file for reading, returns 0 on success
+int kiss_capture_open(kiss_capture_reader_t *reader, const char *path);
+
+// Position the reader at the first frame at or after timestamp, returns 0 or -1 if there is none
+int kiss_capture_seek(kiss_capture_reader_t *reader, uint64_t timestamp);
+
+// Return the next frame, with data pointing into the file. Returns 1 if a frame was read or 0 at the end.
+int kiss_capture_next(kiss_capture_reader_t *reader, uint64_t *timestamp, kiss_packet_t *packet);
+
+// Unmap the file and release the index
+void kiss_capture_close_reader(kiss_capture_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __unix__ || __APPLE__
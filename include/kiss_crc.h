@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+// SMACK marks CRC frames with the top bit of the command byte, leaving ports 0 to 7
+#define KISS_SMACK_FLAG     0x80
+#define KISS_SMACK_PORTS    8
+
+// FlexNet marks CRC frames with bit 5 of the command byte
+#define KISS_FLEX_FLAG      0x20
+
+// What the FlexNet CRC of a frame followed by its CRC comes to
+#define KISS_FLEX_RESIDUE   0x7070
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum kiss_crc_mode {
+    KISS_CRC_NONE = 0,      // Plain KISS
+    KISS_CRC_SMACK = 1,     // Always send SMACK frames
+    KISS_CRC_FLEX = 2,      // Always send FlexNet CRC frames
+    KISS_CRC_AUTO = 3,      // Negotiate SMACK per port
+};
+typedef enum kiss_crc_mode kiss_crc_mode_t;
+
+/**
+ * CRC protection for one KISS link.
+ *
+ * SMACK frames carry a CRC-16 (polynomial 0x8005, reflected, initial value
+ * 0) over the command byte and data, low byte first. FlexNet frames carry
+ * the FlexNet CRC, high byte first. Either way the CRC is escaped like the
+ * data, and the receiver checks it and removes it. So is the command byte,
+ * which is FEND for SMACK data frames on port 4.
+ *
+ * With KISS_CRC_AUTO each port starts out sending SMACK frames, as the SMACK
+ * specification describes. A port that answers with a valid SMACK frame
+ * stays in SMACK mode, and a port that answers with a plain data frame
+ * drops back to plain KISS.
+ *
+ * Give the link to a streaming decoder with kiss_decoder_set_crc, and the
+ * decoder checks the CRC as it unescapes each frame, a run of bytes at a
+ * time. Frames that fail the check are dropped and counted.
+ */
+struct kiss_crc_link {
+    kiss_crc_mode_t mode;
+    uint8_t smack[KISS_SMACK_PORTS];    // Ports currently sending SMACK frames
+    size_t good;                        // Frames that passed the CRC check
+    size_t bad;                         // Frames dropped because the CRC check failed
+};
+typedef struct kiss_crc_link kiss_crc_link_t;
+
+// Create a link in the given mode
+kiss_crc_link_t kiss_new_crc_link(kiss_crc_mode_t mode);
+
+// Update a SMACK CRC-16 with more bytes, eight at a time
+uint16_t kiss_crc16(uint16_t crc, const uint8_t *data, size_t length);
+
+// Update a FlexNet CRC with more bytes, start with 0xFFFF
+uint16_t kiss_crc_flex(uint16_t crc, const uint8_t *data, size_t length);
+
+// Encode a packet with a CRC if the link calls for one, returns bytes written to buffer or 0 if it does not fit
+size_t kiss_encode_packet_crc(kiss_crc_link_t *link, const kiss_packet_t *packet, uint8_t *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+// Entries that share a cache line and are searched together
+#define KISS_DEDUP_WAYS         8
+
+// Parts the window is split into, at most, frames are timed to the nearest part
+#define KISS_DEDUP_BUCKETS      16
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// A remembered frame, 0 time means the entry is free
+struct kiss_dedup_entry {
+    uint32_t fingerprint;       // Hash bits not used to pick the set
+    uint32_t time;              // Time bucket the frame was first seen in, plus one
+};
+typedef struct kiss_dedup_entry kiss_dedup_entry_t;
+
+/**
+ * Drops repeats of the same frame within a time window.
+ *
+ * On a digipeated APRS channel every frame arrives several times a few
+ * seconds apart, once for each path it took. Each decoded frame is hashed
+ * and looked up in a table of recently seen frames. The table is a fixed
+ * array the caller provides, split into sets of KISS_DEDUP_WAYS entries
+ * that each fill one cache line, so a lookup touches one line whatever the
+ * load. Times are stored in buckets of about a sixteenth of the window, which
+ * keeps an entry to 8 bytes, and entries expire simply by being old: a new
+ * frame takes a free or expired entry in its set, or failing that the
+ * oldest one.
+ *
+ * With ignore_path set, the digipeater addresses of AX.25 data frames are
+ * left out of the hash, so copies that came by different paths, or that
+ * have had their has-been-repeated bits set, count as the same frame.
+ *
+ * Times are in whatever unit the caller likes, as long as window is in the
+ * same unit. Not thread safe.
+ */
+struct kiss_dedup {
+    kiss_dedup_entry_t *entries;
+    size_t mask;                // Sets - 1
+    uint64_t bucket_width;      // Window / KISS_DEDUP_BUCKETS, rounded up
+    uint32_t buckets;           // Buckets the window spans, frames older than that have expired
+    uint8_t ignore_path;
+    size_t unique;              // Frames not seen before
+    size_t duplicates;          // Frames seen within the window
+    size_t evicted;             // Frames forgotten before their window ran out, the table is too small
+};
+typedef struct kiss_dedup kiss_dedup_t;
+
+// Initialize with entry_count entries, a power of two and at least KISS_DEDUP_WAYS. Returns 0 on success.
+int kiss_dedup_init(kiss_dedup_t *dedup, kiss_dedup_entry_t *entries, size_t entry_count, uint64_t window, uint8_t ignore_path);
+
+// Forget every frame
+void kiss_dedup_clear(kiss_dedup_t *dedup);
+
+// Return the hash of a frame, as used by kiss_dedup_check
+uint64_t kiss_dedup_hash(const kiss_dedup_t *dedup, const kiss_packet_t *packet);
+
+// Remember a frame seen at now, returns 1 if the same frame was already seen within the window, 0 otherwise
+int kiss_dedup_check(kiss_dedup_t *dedup, const kiss_packet_t *packet, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+#include "kiss_ring.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Called for each frame routed to a port and command
+typedef void (*kiss_handler_t)(const kiss_packet_t *packet, void *context);
+
+struct kiss_port_stats {
+    size_t frames;          // Frames delivered to a handler
+    size_t bytes;           // Decoded data bytes delivered to a handler
+    size_t unhandled;       // Frames dropped because no handler was registered
+};
+typedef struct kiss_port_stats kiss_port_stats_t;
+
+/**
+ * Routes frames to handlers by port and command.
+ *
+ * Handlers live in a table indexed by the two nibbles of the command byte,
+ * so routing a frame is a single lookup. The accept masks mirror the table
+ * and can be given to a streaming decoder with kiss_decoder_set_filter, so
+ * frames that nobody handles are skipped before their data is unescaped.
+ */
+struct kiss_demux {
+    kiss_handler_t handlers[KISS_PORTS][KISS_COMMANDS];
+    void *contexts[KISS_PORTS][KISS_COMMANDS];
+    uint16_t accept[KISS_PORTS];
+    kiss_port_stats_t stats[KISS_PORTS];
+};
+typedef struct kiss_demux kiss_demux_t;
+
+// Initialize a demultiplexer with no handlers
+void kiss_demux_init(kiss_demux_t *demux);
+
+// Register a handler for a port and command, or remove it if handler is 0
+void kiss_demux_register(kiss_demux_t *demux, uint8_t port, kiss_command_t command, kiss_handler_t handler, void *context);
+
+// Route frames to a decoder's packet through this demultiplexer's accept masks
+void kiss_demux_attach(kiss_demux_t *demux, kiss_decoder_t *decoder);
+
+// Route a decoded packet to its handler, returns 1 if a handler was called
+uint8_t kiss_demux_dispatch(kiss_demux_t *demux, const kiss_packet_t *packet);
+
+// Feed bytes to a decoder and dispatch every complete packet, returns bytes consumed
+size_t kiss_demux_push(kiss_demux_t *demux, kiss_decoder_t *decoder, const uint8_t *buffer, size_t buffer_size);
+
+// Dispatch every complete frame in a buffer, decoding wanted frames in place.
+// Returns the number of frames dispatched, resume is set as in kiss_decode_packets.
+size_t kiss_demux_decode(kiss_demux_t *demux, uint8_t *buffer, size_t buffer_size, size_t *resume);
+
+// A handler that queues packets in the kiss_ring_t given as its context
+void kiss_demux_queue_handler(const kiss_packet_t *packet, void *context);
+
+#ifdef __cplusplus
+}
+#endif
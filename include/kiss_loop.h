@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+#include "kiss_demux.h"
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+
+// Bytes read from a stream with each read() call
+#define KISS_LOOP_READ_SIZE     65536
+
+// Reads from one stream before the others get a turn
+#define KISS_LOOP_READ_BUDGET   8
+
+// Events collected by each epoll_wait() call
+#define KISS_LOOP_MAX_EVENTS    64
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Called once when a stream reaches end of file or fails, error is 0 at end of file
+typedef void (*kiss_loop_closed_t)(int fd, int error, void *context);
+
+// A file descriptor with its own decoder
+struct kiss_loop_stream {
+    struct kiss_loop *loop;
+    int fd;
+    kiss_decoder_t decoder;
+    kiss_handler_t handler;
+    kiss_loop_closed_t closed;
+    void *context;
+    uint8_t ready;
+    uint8_t removed;
+    uint8_t hangup;                         // The other end closed or epoll cannot watch it, read until end of file
+    struct kiss_loop_stream *next;          // Every stream in the loop
+    struct kiss_loop_stream *next_ready;    // Streams with data left to read
+};
+typedef struct kiss_loop_stream kiss_loop_stream_t;
+
+/**
+ * A single threaded event loop that decodes many streams at once.
+ *
+ * Each stream is a nonblocking file descriptor, such as a serial port, a
+ * pty or a socket, with its own streaming decoder and handler. The loop
+ * waits on all of them with edge-triggered epoll and decodes whatever
+ * arrives, so one thread can service hundreds of links.
+ *
+ * With edge-triggered events a stream has to be read until it would block.
+ * To stop one busy stream from starving the others, each stream gets
+ * KISS_LOOP_READ_BUDGET reads per turn, and a stream that still has data
+ * waits on a ready list for its next turn.
+ *
+ * Regular files, such as stdin redirected from a file, cannot be watched by
+ * epoll. They are always readable, so they stay on the ready list and are
+ * read with plain read() calls until end of file.
+ *
+ * Handlers run on the loop thread. They may add and remove streams, and a
+ * removed stream is freed once the current turn is over.
+ */
+struct kiss_loop {
+    int epoll_fd;
+    size_t packet_size;
+    size_t stream_count;
+    size_t removed_count;
+    size_t running;
+    kiss_loop_stream_t *streams;
+    kiss_loop_stream_t *ready_head;
+    kiss_loop_stream_t *ready_tail;
+    uint8_t *read_buffer;
+    struct epoll_event events[KISS_LOOP_MAX_EVENTS];
+};
+typedef struct kiss_loop kiss_loop_t;
+
+// Initialize a loop whose packets hold up to packet_size bytes of data, returns 0 on success
+int kiss_loop_init(kiss_loop_t *loop, size_t packet_size);
+
+// Add a file descriptor and make it nonblocking, returns the new stream or 0 on failure.
+// The decoder of the returned stream can be given a filter or stats.
+kiss_loop_stream_t* kiss_loop_add(kiss_loop_t *loop, int fd, kiss_handler_t handler, kiss_loop_closed_t closed, void *context);
+
+// Stop watching a file descriptor, it is not closed. Returns 0 on success.
+int kiss_loop_remove(kiss_loop_t *loop, int fd);
+
+// Wait up to timeout_ms for data and decode it, returns the number of packets handled or -1 on error
+int kiss_loop_run_once(kiss_loop_t *loop, int timeout_ms);
+
+// Run until kiss_loop_stop is called or no streams are left, returns 0 or -1 on error
+int kiss_loop_run(kiss_loop_t *loop);
+
+// Make kiss_loop_run return after the current turn, may be called from a handler
+void kiss_loop_stop(kiss_loop_t *loop);
+
+// Release all streams and memory, file descriptors are not closed
+void kiss_loop_free(kiss_loop_t *loop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+#include "kiss_demux.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct kiss_parallel_options {
+    size_t threads;         // Worker threads, 0 for one per CPU
+    size_t chunk_size;      // Bytes of input per chunk of work, 0 for the default
+    uint8_t ordered;        // Deliver frames in their original order
+};
+typedef struct kiss_parallel_options kiss_parallel_options_t;
+
+/**
+ * Decode a large buffer of encoded frames on a pool of threads.
+ *
+ * The buffer is split into chunks whose boundaries are moved forward to the
+ * next FEND, so every frame falls entirely inside one chunk. Frames without
+ * escapes are handed to the handler as views into the buffer.
+ *
+ * When ordered is 0 the handler is called from the worker threads as soon as
+ * each frame is decoded, and must be thread-safe. Otherwise each worker keeps
+ * the frames of its chunk until every earlier chunk has been delivered, and
+ * the handler is never called by two threads at once.
+ *
+ * A partial frame at the end of the buffer is ignored. Returns the number of
+ * frames delivered, or -1 on error.
+ */
+long long kiss_decode_parallel(const uint8_t *buffer, size_t buffer_size, const kiss_parallel_options_t *options, kiss_handler_t handler, void *context);
+
+// Map a capture file into memory and decode it with kiss_decode_parallel
+long long kiss_decode_file(const char *path, const kiss_parallel_options_t *options, kiss_handler_t handler, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __unix__ || __APPLE__
@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+#include "kiss_ring.h"
+#include "kiss_queue.h"
+#include "kiss_demux.h"
+#include "kiss_pool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <pthread.h>
+
+#define KISS_PIPELINE_MAX_STREAMS   16
+#define KISS_PIPELINE_MAX_CONSUMERS 16
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// What a decoder does when a consumer's queue is full
+enum kiss_queue_policy {
+    KISS_QUEUE_BLOCK = 0,           // Wait for the consumer, applying backpressure
+    KISS_QUEUE_DROP_NEWEST = 1,     // Drop the new packet
+    KISS_QUEUE_DROP_OLDEST = 2,     // Drop the oldest queued packet to make room
+};
+typedef enum kiss_queue_policy kiss_queue_policy_t;
+
+struct kiss_pipeline;
+
+// A file descriptor with its own reader and decoder threads
+struct kiss_pipeline_stream {
+    struct kiss_pipeline *pipeline;
+    int fd;
+    kiss_ring_t ring;
+    kiss_packet_t *packet;      // The pooled buffer the decoder is filling
+    kiss_decoder_t decoder;
+    pthread_t reader_thread;
+    pthread_t decoder_thread;
+    uint8_t reader_started;
+    uint8_t decoder_started;
+    size_t read_eof;
+    size_t done;
+};
+typedef struct kiss_pipeline_stream kiss_pipeline_stream_t;
+
+// A handler with its own queue and thread
+struct kiss_pipeline_consumer {
+    struct kiss_pipeline *pipeline;
+    kiss_handler_t handler;
+    void *context;
+    kiss_queue_policy_t policy;
+    kiss_mpmc_t queue;
+    kiss_mpmc_cell_t *cells;
+    size_t delivered;
+    size_t dropped;
+    pthread_t thread;
+    uint8_t started;
+};
+typedef struct kiss_pipeline_consumer kiss_pipeline_consumer_t;
+
+/**
+ * A threaded reader, decoder and consumer pipeline.
+ *
+ * Each stream has a reader thread that only moves bytes from its file
+ * descriptor into a ring, and a decoder thread that decodes them straight
+ * into a reference counted buffer from a kiss_pool. That one buffer is put
+ * on the queue of every consumer, and goes back to the pool when the last
+ * consumer is done with it, so packets are never copied per consumer. Each
+ * consumer runs its handler on its own thread. Queues are lock-free, and a
+ * slow consumer only affects ingestion if its policy is KISS_QUEUE_BLOCK.
+ *
+ * The pool is sized by kiss_pipeline_start to hold every queue full at once,
+ * plus a packet in the hands of each consumer and each decoder.
+ */
+struct kiss_pipeline {
+    kiss_pipeline_stream_t streams[KISS_PIPELINE_MAX_STREAMS];
+    size_t stream_count;
+    kiss_pipeline_consumer_t consumers[KISS_PIPELINE_MAX_CONSUMERS];
+    size_t consumer_count;
+    size_t packet_size;
+    size_t running;
+    size_t streams_done;
+    kiss_pool_t pool;
+    uint8_t *arena;
+};
+typedef struct kiss_pipeline kiss_pipeline_t;
+
+// Initialize a pipeline whose packets hold up to packet_size bytes of data
+void kiss_pipeline_init(kiss_pipeline_t *pipeline, size_t packet_size);
+
+// Add a file descriptor to read from, ring_size is rounded up to a power of two. Returns 0 on success.
+int kiss_pipeline_add_stream(kiss_pipeline_t *pipeline, int fd, size_t ring_size);
+
+// Add a consumer, queue_size is rounded up to a power of two. Returns 0 on success.
+int kiss_pipeline_add_consumer(kiss_pipeline_t *pipeline, kiss_handler_t handler, void *context, kiss_queue_policy_t policy, size_t queue_size);
+
+// Start all threads, returns 0 on success
+int kiss_pipeline_start(kiss_pipeline_t *pipeline);
+
+// Wait until every stream reaches end of file and every queued packet is handled
+void kiss_pipeline_wait(kiss_pipeline_t *pipeline);
+
+// Stop all threads, dropping anything not yet handled
+void kiss_pipeline_stop(kiss_pipeline_t *pipeline);
+
+// Release all memory used by a stopped pipeline
+void kiss_pipeline_free(kiss_pipeline_t *pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __unix__ || __APPLE__
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+// The default AX.25 I field size
+#define KISS_POOL_AX25_SIZE     256
+#define KISS_POOL_MAX_CLASSES   8
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct kiss_pool;
+
+// A pooled packet buffer, the packet comes first so the two can be converted
+struct kiss_pool_buffer {
+    kiss_packet_t packet;
+    struct kiss_pool *pool;
+    struct kiss_pool_buffer *next;
+    size_t references;
+    uint8_t size_class;
+};
+typedef struct kiss_pool_buffer kiss_pool_buffer_t;
+
+// Buffers that share a data size
+struct kiss_pool_class {
+    size_t data_size;
+    size_t count;
+    size_t available;
+    kiss_pool_buffer_t *free_list;
+    uint8_t lock;
+};
+typedef struct kiss_pool_class kiss_pool_class_t;
+
+/**
+ * A fixed-size pool of reference counted packet buffers.
+ *
+ * Buffers come in size classes, for example a class of AX.25 sized buffers
+ * and a few jumbo buffers. All memory comes from one arena provided by the
+ * caller, which can be a static array on targets without malloc.
+ *
+ * A buffer starts with one reference. Each stage that keeps a packet takes
+ * another reference with kiss_pool_retain and drops it with kiss_pool_release,
+ * and the buffer goes back to the pool when the last reference is dropped.
+ * When built with GCC or Clang, reference counts and free lists are safe to
+ * use from several threads. Other compilers get no atomics and no lock, so
+ * there the pool must only be used from one thread, and not from interrupts.
+ */
+struct kiss_pool {
+    kiss_pool_class_t classes[KISS_POOL_MAX_CLASSES];
+    size_t class_count;
+};
+typedef struct kiss_pool kiss_pool_t;
+
+// Return the arena size needed for the given classes
+size_t kiss_pool_arena_size(const size_t *data_sizes, const size_t *counts, size_t class_count);
+
+// Initialize a pool in an arena, data_sizes must be in ascending order. Returns 0 on success.
+int kiss_pool_init(kiss_pool_t *pool, uint8_t *arena, size_t arena_size, const size_t *data_sizes, const size_t *counts, size_t class_count);
+
+// Take a buffer from the smallest class that holds data_size bytes, or 0 if none are free
+kiss_packet_t* kiss_pool_alloc(kiss_pool_t *pool, size_t data_size);
+
+// Add a reference to a pooled packet
+void kiss_pool_retain(kiss_packet_t *packet);
+
+// Drop a reference to a pooled packet, returning it to the pool when none are left
+void kiss_pool_release(kiss_packet_t *packet);
+
+// Return the number of free buffers in a class
+size_t kiss_pool_available(kiss_pool_t *pool, size_t size_class);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Bounded lock-free queues of packets.
+ *
+ * Each slot is a kiss_packet_t with its own data buffer, so a producer can
+ * decode or copy straight into a slot and a consumer can use the packet in
+ * place before releasing it. Pushing and popping are split into begin/end
+ * calls for that reason: begin returns the slot, end publishes or releases it.
+ *
+ * The caller provides the slot and data storage, so neither queue allocates.
+ * The number of slots must be a power of two.
+ *
+ * A multiple producer, multiple consumer slot can instead carry a reference
+ * counted packet from a kiss_pool in its shared field, so one packet can sit
+ * in several queues without being copied. Such a queue needs no data storage.
+ */
+
+// Single producer, single consumer
+struct kiss_spsc {
+    size_t head;                // Next slot to write, only changed by the producer
+    size_t cached_tail;
+    uint8_t pad0[KISS_CACHE_LINE - 2 * sizeof(size_t)];
+    size_t tail;                // Next slot to read, only changed by the consumer
+    size_t cached_head;
+    uint8_t pad1[KISS_CACHE_LINE - 2 * sizeof(size_t)];
+    kiss_packet_t *slots;
+    size_t mask;
+};
+typedef struct kiss_spsc kiss_spsc_t;
+
+// A slot of a multiple producer, multiple consumer queue
+struct kiss_mpmc_cell {
+    size_t sequence;
+    kiss_packet_t packet;
+    kiss_packet_t *shared;      // Optional, a pooled packet carried instead of a copy
+};
+typedef struct kiss_mpmc_cell kiss_mpmc_cell_t;
+
+// Multiple producer, multiple consumer
+struct kiss_mpmc {
+    kiss_mpmc_cell_t *cells;
+    size_t mask;
+    uint8_t pad0[KISS_CACHE_LINE - sizeof(void *) - sizeof(size_t)];
+    size_t enqueue_position;
+    uint8_t pad1[KISS_CACHE_LINE - sizeof(size_t)];
+    size_t dequeue_position;
+    uint8_t pad2[KISS_CACHE_LINE - sizeof(size_t)];
+};
+typedef struct kiss_mpmc kiss_mpmc_t;
+
+// Initialize a queue with slot_count slots, each using slot_data_size bytes of data. Returns 0 on success.
+int kiss_spsc_init(kiss_spsc_t *queue, kiss_packet_t *slots, size_t slot_count, uint8_t *data, size_t slot_data_size);
+
+// Return an empty slot to fill, or 0 if the queue is full
+kiss_packet_t* kiss_spsc_begin_push(kiss_spsc_t *queue);
+
+// Publish the slot returned by kiss_spsc_begin_push
+void kiss_spsc_end_push(kiss_spsc_t *queue);
+
+// Return the oldest packet, or 0 if the queue is empty
+kiss_packet_t* kiss_spsc_begin_pop(kiss_spsc_t *queue);
+
+// Release the slot returned by kiss_spsc_begin_pop
+void kiss_spsc_end_pop(kiss_spsc_t *queue);
+
+// Initialize a queue with slot_count slots, each using slot_data_size bytes of data, which may be 0 for shared packets. Returns 0 on success.
+int kiss_mpmc_init(kiss_mpmc_t *queue, kiss_mpmc_cell_t *cells, size_t slot_count, uint8_t *data, size_t slot_data_size);
+
+// Claim an empty slot to fill, or 0 if the queue is full
+kiss_mpmc_cell_t* kiss_mpmc_begin_push(kiss_mpmc_t *queue);
+
+// Publish a slot returned by kiss_mpmc_begin_push
+void kiss_mpmc_end_push(kiss_mpmc_t *queue, kiss_mpmc_cell_t *cell);
+
+// Claim the oldest packet, or 0 if the queue is empty
+kiss_mpmc_cell_t* kiss_mpmc_begin_pop(kiss_mpmc_t *queue);
+
+// Release a slot returned by kiss_mpmc_begin_pop
+void kiss_mpmc_end_pop(kiss_mpmc_t *queue, kiss_mpmc_cell_t *cell);
+
+// Copy a packet into a slot, truncating data to the slot size
+void kiss_copy_packet(kiss_packet_t *destination, const kiss_packet_t *source);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * A power-of-two ring buffer for incoming encoded data.
+ *
+ * One producer (a read loop or a UART interrupt) writes bytes into the ring
+ * and one consumer feeds them to a streaming decoder. Bytes are never moved
+ * once they have been received, and nothing is ever dropped to make room:
+ * the decoder resynchronizes on the next FEND by itself.
+ *
+ * On Linux the ring can also be mirrored, which maps the same memory twice
+ * back to back so the readable bytes are always contiguous, even across the
+ * wrap. This lets kiss_decode_packets and kiss_frame_data work on the ring
+ * directly.
+ */
+struct kiss_ring {
+    uint8_t *buffer;
+    size_t mask;            // Capacity - 1
+    size_t head;            // Total bytes written, only changed by the producer
+    size_t tail;            // Total bytes read, only changed by the consumer
+    size_t dropped;         // Bytes kiss_ring_write could not fit
+    uint8_t mirrored;
+};
+typedef struct kiss_ring kiss_ring_t;
+
+// Create a ring using a buffer whose size is a power of two, returns a ring with no capacity otherwise
+kiss_ring_t kiss_new_ring(uint8_t *buffer, size_t buffer_size);
+
+// Create a mirrored ring, capacity is rounded up to a power of two and the page size. Returns 0 on success.
+int kiss_new_mirrored_ring(kiss_ring_t *ring, size_t capacity);
+
+// Release the memory of a mirrored ring
+void kiss_free_mirrored_ring(kiss_ring_t *ring);
+
+// Return the number of bytes waiting to be read
+size_t kiss_ring_length(const kiss_ring_t *ring);
+
+// Return the number of bytes that can be written
+size_t kiss_ring_space(const kiss_ring_t *ring);
+
+// Return where the producer can write next, and how many contiguous bytes fit there
+uint8_t* kiss_ring_write_ptr(kiss_ring_t *ring, size_t *available);
+
+// Make bytes written through kiss_ring_write_ptr visible to the consumer
+void kiss_ring_commit(kiss_ring_t *ring, size_t bytes);
+
+// Copy bytes into the ring, returns bytes written. Bytes that do not fit are counted in dropped.
+size_t kiss_ring_write(kiss_ring_t *ring, const uint8_t *data, size_t data_size);
+
+// Return where the consumer can read next, and how many contiguous bytes are there
+uint8_t* kiss_ring_read_ptr(kiss_ring_t *ring, size_t *available);
+
+// Release bytes read through kiss_ring_read_ptr back to the producer
+void kiss_ring_consume(kiss_ring_t *ring, size_t bytes);
+
+// Feed buffered bytes to a decoder, returns bytes consumed.
+// Stops after the end of a packet, check decoder->packet.complete_packet.
+size_t kiss_ring_decode(kiss_ring_t *ring, kiss_decoder_t *decoder);
+
+// Queue a whole packet as one record, returns 1 on success or 0 if it does not fit.
+// Packet data is limited to 65535 bytes.
+uint8_t kiss_ring_put_packet(kiss_ring_t *ring, const kiss_packet_t *packet);
+
+// Take the next packet record, copying its data into packet->data. Returns 1 if a packet was read.
+uint8_t kiss_ring_get_packet(kiss_ring_t *ring, kiss_packet_t *packet);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+#include "kiss_demux.h"
+#include "kiss_pool.h"
+#include "kiss_ring.h"
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+
+// The usual TCP port for KISS over TCP
+#define KISS_SERVER_PORT        8001
+
+// Frames sent to a client with each sendmsg() call
+#define KISS_SERVER_MAX_IOV     64
+
+// Bytes read from a client at a time
+#define KISS_SERVER_INPUT_SIZE  4096
+
+// Events collected by each epoll_wait() call
+#define KISS_SERVER_MAX_EVENTS  64
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct kiss_server_options {
+    uint16_t port;              // TCP port to listen on, 0 picks a free port
+    size_t packet_size;         // Largest decoded frame, from the TNC or a client
+    size_t queue_size;          // Frames queued for a client before it is evicted
+    size_t buffers;             // Encoded frames shared between all clients at once
+    size_t max_clients;
+    size_t tnc_buffer_size;     // Bytes of client frames waiting to be written to the TNC
+};
+typedef struct kiss_server_options kiss_server_options_t;
+
+// A connected client
+struct kiss_server_client {
+    int fd;                     // -1 when the slot is free
+    uint32_t events;            // Events currently registered with epoll
+    kiss_packet_t **queue;      // Encoded frames to send, each holds a pool reference
+    size_t mask;
+    size_t head;
+    size_t tail;
+    size_t offset;              // Bytes of the oldest frame already sent
+    kiss_decoder_t decoder;     // Frames sent by the client, on their way to the TNC
+    uint8_t *input;
+    size_t input_start;
+    size_t input_end;
+    uint8_t blocked;            // A decoded frame is waiting for room in the TNC buffer
+};
+typedef struct kiss_server_client kiss_server_client_t;
+
+struct kiss_server_stats {
+    size_t accepted;            // Clients connected
+    size_t rejected;            // Clients turned away because every slot was in use
+    size_t disconnected;        // Clients that closed their connection or failed
+    size_t evicted;             // Clients dropped because their queue was full
+    size_t broadcast;           // Frames sent to every client
+    size_t dropped;             // Frames not sent because no shared buffer was free or they could not be encoded
+    size_t inbound;             // Frames from clients passed on to the TNC
+};
+typedef struct kiss_server_stats kiss_server_stats_t;
+
+/**
+ * A KISS over TCP server that shares one TNC between many applications.
+ *
+ * Every frame from the TNC is encoded once into a reference counted buffer
+ * from a kiss_pool_t, and each client queues a reference to it, so the cost
+ * of a frame does not grow with the encoding work per client. Queued frames
+ * are sent with one vectored write per client per turn. A client whose
+ * queue fills up is too slow to keep up and is evicted, so it cannot hold
+ * buffers or memory hostage.
+ *
+ * Frames sent by clients are decoded so that only whole frames reach the
+ * TNC, never interleaved with another client's. When the TNC falls behind,
+ * clients take turns: each blocked client gets one frame in per round, and
+ * a blocked client is not read from, so TCP pushes back on it.
+ *
+ * Everything runs on one thread, driven by kiss_server_run_once.
+ */
+struct kiss_server {
+    int epoll_fd;
+    int listen_fd;
+    int tnc_fd;
+    uint8_t tnc_writing;        // Waiting for the TNC to become writable
+    kiss_server_options_t options;
+    kiss_server_client_t *clients;
+    size_t client_count;
+    size_t next_client;         // Where the next round of inbound frames starts
+    kiss_pool_t pool;
+    uint8_t *arena;
+    kiss_decoder_t tnc_decoder;
+    kiss_ring_t tnc_out;
+    uint8_t *scratch;           // Holds a client frame while it is encoded for the TNC
+    kiss_handler_t inbound;
+    void *inbound_context;
+    kiss_server_stats_t stats;
+    struct epoll_event events[KISS_SERVER_MAX_EVENTS];
+};
+typedef struct kiss_server kiss_server_t;
+
+// Return options with the usual port and sizes suited to AX.25
+kiss_server_options_t kiss_new_server_options(void);
+
+// Start listening for clients, returns 0 on success
+int kiss_server_init(kiss_server_t *server, const kiss_server_options_t *options);
+
+// Return the TCP port the server is listening on
+uint16_t kiss_server_port(const kiss_server_t *server);
+
+// Read frames from a TNC and send them to every client, and write client frames to it. Returns 0 on success.
+int kiss_server_set_tnc(kiss_server_t *server, int fd);
+
+// Call handler for every frame a client sends, after it is accepted for the TNC
+void kiss_server_set_inbound(kiss_server_t *server, kiss_handler_t handler, void *context);
+
+// Encode a frame once and queue it for every client, returns 0 on success or -1 if it was dropped.
+// Queued frames are sent by the next kiss_server_run_once.
+int kiss_server_broadcast(kiss_server_t *server, const kiss_packet_t *packet);
+
+// Wait up to timeout_ms for activity and handle it, returns 0 on success or -1 on error
+int kiss_server_run_once(kiss_server_t *server, int timeout_ms);
+
+// Disconnect every client and release all memory, the TNC is not closed
+void kiss_server_free(kiss_server_t *server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
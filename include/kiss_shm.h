@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+#if defined(__linux__)
+
+#define KISS_SHM_MAGIC      0x4B495353  // "KISS"
+#define KISS_SHM_VERSION    1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Shared state at the start of the mapping, each field written by a different party has its own cache line
+struct kiss_shm_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slot_count;        // A power of two
+    uint64_t slot_size;         // Data bytes per slot
+    uint64_t slot_stride;       // Bytes from one slot to the next
+    uint8_t pad0[KISS_CACHE_LINE - 32];
+    uint64_t head;              // Frames published, only written by the writer
+    uint8_t pad1[KISS_CACHE_LINE - 8];
+    uint32_t futex;             // Bumped when a frame is published while readers wait
+    uint32_t waiters;           // Readers sleeping on the futex
+    uint8_t pad2[KISS_CACHE_LINE - 8];
+};
+typedef struct kiss_shm_header kiss_shm_header_t;
+
+// A frame slot, the data follows it
+struct kiss_shm_slot {
+    uint64_t sequence;          // Odd while the writer is filling the slot
+    uint32_t length;
+    uint8_t command;
+    uint8_t port;
+    uint16_t reserved;
+};
+typedef struct kiss_shm_slot kiss_shm_slot_t;
+
+/**
+ * A ring of frame slots in shared memory, for handing frames to other processes.
+ *
+ * One process writes frames and any number of readers follow along, each
+ * with its own cursor. Nothing is copied through the kernel: a reader sees
+ * a frame as soon as the writer publishes it, and can use it in place.
+ *
+ * The writer never waits for readers. A reader that falls more than a ring
+ * behind finds its frames overwritten, which each slot detects with a
+ * sequence number, and is told how many frames it missed.
+ *
+ * Readers with nothing to do sleep on a futex in the shared header. The
+ * writer only makes a system call to wake them when someone is waiting.
+ */
+struct kiss_shm {
+    kiss_shm_header_t *header;
+    uint8_t *slots;
+    size_t size;
+    int fd;
+};
+typedef struct kiss_shm kiss_shm_t;
+
+// A reader's position in the ring
+struct kiss_shm_reader {
+    kiss_shm_t *shm;
+    uint64_t cursor;            // The next frame to read
+    uint64_t overruns;          // Frames lost because the reader fell behind
+};
+typedef struct kiss_shm_reader kiss_shm_reader_t;
+
+// Create a ring of slot_count slots holding slot_size bytes each, rounded up to a power of two.
+// With a name it can be opened by name with kiss_shm_open, without one the fd must be passed on.
+// Returns 0 on success.
+int kiss_shm_create(kiss_shm_t *shm, const char *name, size_t slot_count, size_t slot_size);
+
+// Map a ring created by another process under a name, returns 0 on success
+int kiss_shm_open(kiss_shm_t *shm, const char *name);
+
+// Map a ring from a file descriptor, for example one passed over a unix socket. Returns 0 on success.
+int kiss_shm_attach(kiss_shm_t *shm, int fd);
+
+// Unmap a ring and close its file descriptor, a named ring also needs shm_unlink
+void kiss_shm_close(kiss_shm_t *shm);
+
+// Return a packet whose data is the next slot, so a frame can be decoded straight into it
+kiss_packet_t kiss_shm_begin_write(kiss_shm_t *shm);
+
+// Publish the packet returned by kiss_shm_begin_write and wake waiting readers
+void kiss_shm_end_write(kiss_shm_t *shm, const kiss_packet_t *packet);
+
+// Copy a packet into the next slot and publish it, returns 0 on success or -1 if it does not fit
+int kiss_shm_write(kiss_shm_t *shm, const kiss_packet_t *packet);
+
+// Create a reader that starts with the next frame published
+kiss_shm_reader_t kiss_new_shm_reader(kiss_shm_t *shm);
+
+// Copy the next frame into packet. Returns 1 if a frame was read, 0 if there is none yet,
+// or -1 if the reader fell behind, in which case it skips ahead and can read again.
+int kiss_shm_read(kiss_shm_reader_t *reader, kiss_packet_t *packet);
+
+// Point packet at the next frame in shared memory without copying, returns like kiss_shm_read
+int kiss_shm_peek(kiss_shm_reader_t *reader, kiss_packet_t *packet);
+
+// Move past a peeked frame, returns 0 or -1 if it was overwritten while in use
+int kiss_shm_release(kiss_shm_reader_t *reader);
+
+// Sleep until a frame is available or timeout_ms passes, -1 waits forever. Returns 1 if a frame is available.
+int kiss_shm_wait(kiss_shm_reader_t *reader, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
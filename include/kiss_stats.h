@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+
+// Number of log2 buckets in each histogram, bucket n counts values below 2^n
+#define KISS_STATS_BUCKETS 32
+
+#if defined(__GNUC__)
+#define KISS_STATS_ALIGNED __attribute__((aligned(KISS_CACHE_LINE)))
+#else
+#define KISS_STATS_ALIGNED
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Counters kept by a streaming decoder.
+ *
+ * Give each decoder its own kiss_stats_t with kiss_decoder_set_stats. Only
+ * the decoding thread writes to it, and it is aligned to a cache line so two
+ * decoders never share one. Other threads should read it through
+ * kiss_stats_snapshot, which copies it without stopping the decoder.
+ *
+ * Counting costs a branch per frame, escape or skipped run, not per byte.
+ * Build with KISS_NO_STATS defined to compile the counting out completely.
+ *
+ * The histograms are only filled in when histograms is non-zero. Latency
+ * is measured from the push that delivered the command byte of a frame to
+ * the push that delivered its final FEND, using the now field, which the
+ * caller sets before each push in whatever time unit it likes.
+ *
+ * The per-port counters only cover frames whose command byte has been read.
+ * Dropped and filtered bytes are decoder-wide only: dropped bytes are seen
+ * outside of any frame, and filtered frames are skipped before their port is
+ * decoded. CRC errors are decoder-wide too, since a bad CRC may have garbled
+ * the port.
+ */
+struct kiss_decoder_port_stats {
+    size_t frames;          // Complete frames decoded on this port, including empty ones
+    size_t empty_frames;    // Frames on this port with a command byte but no data
+    size_t bytes_in;        // Encoded bytes of complete frames, command byte to final FEND
+    size_t bytes_out;       // Decoded data bytes of complete frames on this port
+    size_t escapes;         // Escape sequences seen in frames on this port
+    size_t truncated;       // Frames on this port longer than the data buffer
+    size_t invalid_escapes; // FESC followed by something other than TFEND or TFESC
+};
+typedef struct kiss_decoder_port_stats kiss_decoder_port_stats_t;
+
+struct kiss_stats {
+    uint64_t now;               // Current time, set by the caller before each push
+    uint8_t histograms;         // Non-zero to fill in the histograms
+
+    size_t bytes_in;            // Encoded bytes pushed to the decoder
+    size_t bytes_out;           // Decoded data bytes of complete frames
+    size_t frames;              // Complete frames, including empty ones
+    size_t empty_frames;        // Frames with a command byte but no data
+    size_t escapes;             // Escape sequences seen
+    size_t invalid_escapes;     // Escape sequences that were not TFEND or TFESC
+    size_t truncated;           // Frames longer than the data buffer
+    size_t truncated_bytes;     // Data bytes lost to truncation
+    size_t dropped_bytes;       // Bytes outside of any frame, while resynchronizing
+    size_t filtered_frames;     // Frames skipped by the decoder filter
+    size_t filtered_bytes;      // Bytes of frames skipped by the decoder filter
+    size_t crc_errors;          // Frames dropped because their SMACK or FlexNet CRC was wrong
+
+    kiss_decoder_port_stats_t ports[KISS_PORTS];
+
+    size_t size_histogram[KISS_STATS_BUCKETS];      // Decoded frame sizes
+    size_t latency_histogram[KISS_STATS_BUCKETS];   // Time from command byte to final FEND
+
+    // Decoder bookkeeping for the frame in progress
+    uint64_t frame_start;
+    size_t frame_lost;
+    size_t frame_in;
+} KISS_STATS_ALIGNED;
+typedef struct kiss_stats kiss_stats_t;
+
+// Reset all counters and histograms to zero
+void kiss_stats_init(kiss_stats_t *stats, uint8_t histograms);
+
+// Copy the counters, safe to call while another thread is decoding
+void kiss_stats_snapshot(const kiss_stats_t *stats, kiss_stats_t *snapshot);
+
+// Return the histogram bucket for a value, the number of bits needed to hold it
+uint8_t kiss_stats_bucket(uint64_t value);
+
+#ifdef __cplusplus
+}
+#endif
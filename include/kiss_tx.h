@@ -0,0 +1,126 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+#include "kiss_ring.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#endif
+
+// Bytes of parameter and SET_HARDWARE frames that can wait at once, a power of two
+#define KISS_TX_CONTROL_SIZE    512
+
+// Buffers kiss_tx_prepare can return
+#define KISS_TX_MAX_IOV         6
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct kiss_tx_stats {
+    size_t frames;              // Data frames queued
+    size_t parameters;          // Parameter frames sent to the TNC
+    size_t deduplicated;        // Parameter updates replaced by a newer one or already in effect
+    size_t dropped;             // Frames refused because the queue was full
+    size_t writes;              // Calls to kiss_tx_flush that wrote something
+    size_t bytes;               // Bytes written
+};
+typedef struct kiss_tx_stats kiss_tx_stats_t;
+
+/**
+ * A transmit queue that batches frames for the TNC.
+ *
+ * Frames are encoded as they are queued, and everything waiting is written
+ * with one vectored write, so a burst of beacons costs one system call
+ * instead of one per frame.
+ *
+ * Parameter frames (TX delay, persistence, slot time, TX tail and full
+ * duplex) are not queued as frames. The queue keeps the latest value of
+ * each parameter on each port and sends it ahead of the data, so a burst
+ * of updates becomes one frame and an update the TNC already has is not
+ * sent at all. SET_HARDWARE and RETURN frames go out ahead of the data
+ * too, in the order they were queued. Nothing is ever put in the middle of
+ * a data frame that is partly written.
+ *
+ * With a rate set, the queue paces its output to the link. It models the
+ * TNC buffer as a bucket that holds burst bytes and drains at the link
+ * rate, and never writes more than the free space, so the TNC has no
+ * reason to drop frames under bursty load.
+ *
+ * Times are in nanoseconds, from any clock that does not go backwards. The
+ * control ring points into the structure, so it must not be moved once
+ * initialized. A queue is not thread safe.
+ */
+struct kiss_tx {
+    kiss_ring_t data;           // Encoded data frames
+    kiss_ring_t control;        // Encoded SET_HARDWARE, RETURN and parameter frames
+    size_t data_fends;          // FENDs written from data, odd while a frame is partly written
+    size_t planned_first;       // Bytes of the partly written frame in the last kiss_tx_prepare
+    size_t planned_control;     // Control bytes in the last kiss_tx_prepare
+    uint8_t values[KISS_PORTS][KISS_SET_HARDWARE];  // Latest value of each parameter
+    uint16_t pending[KISS_PORTS];   // Parameters waiting to be sent, one bit per command
+    uint16_t known[KISS_PORTS];     // Parameters the TNC already has
+    uint64_t rate;              // Bytes per second the link can take, 0 to write as fast as possible
+    size_t burst;               // Bytes the TNC can buffer
+    size_t tokens;              // Bytes that can be written now
+    uint64_t last;              // When tokens was last topped up
+    kiss_tx_stats_t stats;
+    uint8_t control_buffer[KISS_TX_CONTROL_SIZE];
+};
+typedef struct kiss_tx kiss_tx_t;
+
+// Initialize a queue whose data buffer size is a power of two, returns 0 on success
+int kiss_tx_init(kiss_tx_t *tx, uint8_t *buffer, size_t buffer_size);
+
+// Pace output to bits_per_second, never having more than burst bytes in the TNC. 0 turns pacing off.
+void kiss_tx_set_rate(kiss_tx_t *tx, uint64_t bits_per_second, size_t burst, uint64_t now);
+
+// Queue a frame, returns 0 on success or -1 if there is no room for it
+int kiss_tx_queue(kiss_tx_t *tx, const kiss_packet_t *packet);
+
+// Forget which parameter values the TNC has, so they are all sent again, e.g. after it resets
+void kiss_tx_reset_parameters(kiss_tx_t *tx);
+
+// Return the number of bytes waiting to be written
+size_t kiss_tx_length(const kiss_tx_t *tx);
+
+// Fill iov with what can be written now, returns the number of buffers used. iov must hold KISS_TX_MAX_IOV.
+size_t kiss_tx_prepare(kiss_tx_t *tx, kiss_iovec_t *iov, uint64_t now);
+
+// Release bytes written from the buffers returned by the last kiss_tx_prepare
+void kiss_tx_consume(kiss_tx_t *tx, size_t bytes);
+
+// Return how long until more can be written, 0 if it can be written now or nothing is waiting
+uint64_t kiss_tx_delay(const kiss_tx_t *tx, uint64_t now);
+
+#if defined(__unix__) || defined(__APPLE__)
+// Write what the rate allows to fd with one writev(), returns bytes written, 0 if fd would block, or -1 on error
+ssize_t kiss_tx_flush(kiss_tx_t *tx, int fd, uint64_t now);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
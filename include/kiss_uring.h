@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "kiss.h"
+#include "kiss_capture.h"
+#include "kiss_loop.h"
+#include "kiss_tx.h"
+
+#if defined(__linux__)
+
+// Submission queue entries
+#define KISS_URING_ENTRIES      256
+
+// Read buffers shared by every stream, a power of two
+#define KISS_URING_BUFFERS      64
+
+// Bytes in each read buffer
+#define KISS_URING_BUFFER_SIZE  16384
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum kiss_uring_backend {
+    KISS_URING_IO_URING = 0,
+    KISS_URING_EPOLL = 1,       // io_uring is not available, a kiss_loop_t does the reading
+};
+typedef enum kiss_uring_backend kiss_uring_backend_t;
+
+// An operation in flight, its completion points back to it
+struct kiss_uring_op {
+    uint8_t type;
+    uint8_t busy;               // Submitted and not completed yet
+    void *owner;
+};
+typedef struct kiss_uring_op kiss_uring_op_t;
+
+// A file descriptor with its own decoder, and optionally a transmit queue
+struct kiss_uring_stream {
+    struct kiss_uring *ring;
+    int fd;
+    kiss_decoder_t decoder;
+    kiss_handler_t handler;     // 0 for a stream that is only written to
+    kiss_loop_closed_t closed;
+    void *context;
+    kiss_tx_t *tx;              // Set by kiss_uring_send
+    kiss_iovec_t iov[KISS_TX_MAX_IOV];  // What the write in flight is sending
+    kiss_uring_op_t read;
+    kiss_uring_op_t write;
+    uint8_t removed;
+    kiss_loop_stream_t *fallback;       // The stream in the epoll backend
+    struct kiss_uring_stream *next;
+};
+typedef struct kiss_uring_stream kiss_uring_stream_t;
+
+struct kiss_uring_stats {
+    size_t enters;              // io_uring_enter() calls, the only system calls made per turn
+    size_t completions;
+    size_t reads;               // Reads that returned data
+    size_t writes;              // Writes to streams and capture files
+    size_t errors;              // Capture writes that failed
+};
+typedef struct kiss_uring_stats kiss_uring_stats_t;
+
+/**
+ * An io_uring event loop for decoding many streams and writing frames and
+ * capture files, with far fewer system calls than read() and write().
+ *
+ * Every stream keeps a read in flight. Reads take their memory from a ring
+ * of KISS_URING_BUFFERS buffers registered with the kernel, so memory does
+ * not grow with the number of streams: the kernel picks a buffer when data
+ * arrives, the buffer goes straight to the stream's decoder, and then back
+ * to the ring. Frames queued on a kiss_tx_t are sent as one vectored write
+ * per stream, and full capture blocks are written without waiting for
+ * them. New operations are collected in the submission queue and handed to
+ * the kernel together, by the same io_uring_enter() that waits for the
+ * next completions, so a busy turn costs one system call.
+ *
+ * When io_uring or provided buffer rings are not available, from an old
+ * kernel, a seccomp policy or missing headers, kiss_uring_init falls back
+ * to a kiss_loop_t for reading and to ordinary writes, with the same API.
+ * The backend field says which one is in use.
+ *
+ * io_uring waits for data itself, so streams are put in blocking mode, and
+ * in nonblocking mode for the epoll backend. Handlers run on the loop thread
+ * and may add and remove streams.
+ */
+struct kiss_uring {
+    kiss_uring_backend_t backend;
+    int fd;
+    size_t packet_size;
+    kiss_uring_stream_t *streams;
+    size_t stream_count;
+    size_t removed_count;
+    size_t writes_in_flight;    // Stream and capture writes not completed yet
+    size_t senders;             // Streams with a transmit queue
+    uint8_t running;
+    uint8_t retry;              // Something could not be submitted, try again next turn
+    // Submission queue, shared with the kernel
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t sq_local_tail;     // Entries filled in, the kernel sees them at the next io_uring_enter()
+    uint32_t sq_submitted;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    // Completion queue, shared with the kernel
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+    void *map;                  // Both queues
+    size_t map_size;
+    // Read buffers provided to the kernel
+    struct io_uring_buf_ring *buffer_ring;
+    size_t buffer_ring_size;
+    uint16_t buffer_tail;
+    uint8_t *buffers;
+    kiss_loop_t loop;           // The epoll backend
+    kiss_uring_stats_t stats;
+};
+typedef struct kiss_uring kiss_uring_t;
+
+// Initialize with io_uring if possible and epoll otherwise, packets hold up to packet_size bytes. Returns 0 on success.
+int kiss_uring_init(kiss_uring_t *ring, size_t packet_size);
+
+// Initialize with the epoll backend, whether or not io_uring is available. Returns 0 on success.
+int kiss_uring_init_epoll(kiss_uring_t *ring, size_t packet_size);
+
+// Add a file descriptor, returns the new stream or 0 on failure. With no handler the stream is only written to.
+kiss_uring_stream_t* kiss_uring_add(kiss_uring_t *ring, int fd, kiss_handler_t handler, kiss_loop_closed_t closed, void *context);
+
+// Stop reading and writing a stream, the file descriptor is not closed. Returns 0 on success.
+int kiss_uring_remove(kiss_uring_t *ring, kiss_uring_stream_t *stream);
+
+// Send the frames queued on tx to a stream, and keep sending as more are queued. Returns 0 on success.
+int kiss_uring_send(kiss_uring_t *ring, kiss_uring_stream_t *stream, kiss_tx_t *tx);
+
+// Record a frame, a full block is written in the background. Returns 0 on success.
+int kiss_uring_capture(kiss_uring_t *ring, kiss_capture_writer_t *writer, uint64_t timestamp, const kiss_packet_t *packet);
+
+// Start writing the current capture block in the background, returns 0 on success
+int kiss_uring_capture_flush(kiss_uring_t *ring, kiss_capture_writer_t *writer);
+
+// Wait up to timeout_ms for activity and handle it, returns the number of packets handled or -1 on error
+int kiss_uring_run_once(kiss_uring_t *ring, int timeout_ms);
+
+// Run until kiss_uring_stop is called or no streams are left, returns 0 or -1 on error
+int kiss_uring_run(kiss_uring_t *ring);
+
+// Make kiss_uring_run return after the current turn, may be called from a handler
+void kiss_uring_stop(kiss_uring_t *ring);
+
+// Wait for every write in flight, call before closing a capture file. Returns 0 on success.
+int kiss_uring_drain(kiss_uring_t *ring);
+
+// Release all streams and memory, file descriptors are not closed
+void kiss_uring_free(kiss_uring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
@@ -21,33 +21,83 @@ SOFTWARE.
 */
 
 #include "kiss.h"
+#include "kiss_stats.h"
+#include "kiss_ax25.h"
+#include "kiss_crc.h"
+#include "kiss_atomic.h"
+
+#include <string.h>
+
+#ifndef KISS_NO_STATS
+// Only the decoding thread writes the counters, relaxed stores keep snapshots from tearing
+#define KISS_STAT_ADD(field, v) KISS_STORE_RELAXED(&(field), (field) + (v))
+#define KISS_STAT(statements) do { if (stats) { statements; } } while (0)
+#else
+#define KISS_STAT(statements) do { } while (0)
+#endif
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+// Check the first few bytes directly, so dense escapes do not pay for a full scan each time
+static inline size_t kiss_next_special(const uint8_t *buffer, size_t buffer_size) {
+    size_t n = (buffer_size < 8) ? buffer_size : 8;
+    for (size_t i = 0; i < n; i++) {
+        if (buffer[i] == KISS_FRAME_END || buffer[i] == KISS_FRAME_ESCAPE) return i;
+    }
+    return n + kiss_find_special(buffer + n, buffer_size - n);
+}
+
+// Copy a run of bytes forwards, short runs are not worth a call to memcpy.
+// Safe for overlapping buffers when destination comes first.
+static inline void kiss_copy_run(uint8_t *destination, const uint8_t *source, size_t length) {
+    if (length < 16) {
+        for (size_t i = 0; i < length; i++) destination[i] = source[i];
+    } else {
+        memmove(destination, source, length);
+    }
+}
+
+// Translate the byte after a FESC, returns the number of bytes used or 0 at the end of the data
+static inline size_t kiss_unescape(const uint8_t *encoded, size_t encoded_length, uint8_t *b) {
+    // Repeated escapes are skipped
+    size_t i = 1;
+    while (i < encoded_length && encoded[i] == KISS_FRAME_ESCAPE) i++;
+    if (i >= encoded_length) return 0;
+    *b = encoded[i];
+    if (*b == KISS_ESCAPE_FEND) {
+        *b = KISS_FRAME_END;
+    } else if (*b == KISS_ESCAPE_FESC) {
+        *b = KISS_FRAME_ESCAPE;
+    }
+    return i + 1;
+}
+
 // Encode packet data
 size_t kiss_encode_data(uint8_t *decoded, size_t decoded_length, uint8_t *encoded, size_t encoded_length) {
     size_t len = 0;
-    for (size_t i = 0; i < decoded_length; i++) {
+    size_t i = 0;
+    while (i < decoded_length) {
         if (len >= encoded_length) return len;
         uint8_t b = decoded[i];
-        switch (b) {
-            case KISS_FRAME_END:
-                encoded[len++] = KISS_FRAME_ESCAPE;
-                if (len >= encoded_length) return len;
-                encoded[len++] = KISS_ESCAPE_FEND;
-                break;
-            case KISS_FRAME_ESCAPE:
-                encoded[len++] = KISS_FRAME_ESCAPE;
-                if (len >= encoded_length) return len;
-                encoded[len++] = KISS_ESCAPE_FESC;
-                break;
-            default:
-                encoded[len++] = b;
-                break;
+        if (b == KISS_FRAME_END || b == KISS_FRAME_ESCAPE) {
+            encoded[len++] = KISS_FRAME_ESCAPE;
+            if (len >= encoded_length) return len;
+            encoded[len++] = (b == KISS_FRAME_END) ? KISS_ESCAPE_FEND : KISS_ESCAPE_FESC;
+            i++;
+            continue;
         }
+
+        // Copy everything up to the next byte that needs escaping
+        encoded[len++] = b;
+        i++;
+        size_t run = kiss_next_special(decoded + i, decoded_length - i);
+        if (run > encoded_length - len) run = encoded_length - len;
+        kiss_copy_run(encoded + len, decoded + i, run);
+        len += run;
+        i += run;
     }
     return len;
 }
@@ -55,35 +105,50 @@ size_t kiss_encode_data(uint8_t *decoded, size_t decoded_length, uint8_t *encode
 // Decode packet data
 size_t kiss_decode_data(uint8_t *encoded, size_t encoded_length, uint8_t *decoded, size_t decoded_length) {
     size_t len = 0;
-    uint8_t in_escape = 0;
-    for (size_t i = 0; i < encoded_length; i++) {
+    size_t i = 0;
+    while (i < encoded_length) {
         if (len >= decoded_length) return len;
         uint8_t b = encoded[i];
-        switch (b) {
-            case KISS_FRAME_ESCAPE:
-                in_escape = 1;
-                break;
-            case KISS_ESCAPE_FEND:
-                if (in_escape) {
-                    decoded[len++] = KISS_FRAME_END;
-                    in_escape = 0;
-                } else {
-                    decoded[len++] = b;
-                }
-                break;
-            case KISS_ESCAPE_FESC:
-                if (in_escape) {
-                    decoded[len++] = KISS_FRAME_ESCAPE;
-                    in_escape = 0;
-                } else {
-                    decoded[len++] = b;
-                }
-                break;
-            default:
-                decoded[len++] = b;
-                in_escape = 0;
-                break;
+        if (b == KISS_FRAME_ESCAPE) {
+            size_t used = kiss_unescape(encoded + i, encoded_length - i, &b);
+            if (!used) return len;
+            decoded[len++] = b;
+            i += used;
+            continue;
+        }
+
+        // Copy everything up to the next escape
+        decoded[len++] = b;
+        i++;
+        size_t run = kiss_next_special(encoded + i, encoded_length - i);
+        if (run > decoded_length - len) run = decoded_length - len;
+        kiss_copy_run(decoded + len, encoded + i, run);
+        len += run;
+        i += run;
+    }
+    return len;
+}
+
+// Decode packet data within the same buffer, returns the decoded length
+size_t kiss_decode_data_in_place(uint8_t *data, size_t data_length) {
+    // Nothing moves until the first escape
+    size_t i = kiss_find_special(data, data_length);
+    size_t len = i;
+    while (i < data_length) {
+        uint8_t b = data[i];
+        if (b == KISS_FRAME_ESCAPE) {
+            size_t used = kiss_unescape(data + i, data_length - i, &b);
+            if (!used) break;
+            data[len++] = b;
+            i += used;
+            continue;
         }
+
+        // Shift the clean run down over the removed escape bytes
+        size_t run = 1 + kiss_next_special(data + i + 1, data_length - i - 1);
+        kiss_copy_run(data + len, data + i, run);
+        len += run;
+        i += run;
     }
     return len;
 }
@@ -102,13 +167,72 @@ void kiss_decode_command(uint8_t b, kiss_command_t *command, uint8_t *port) {
 // Encode a packet, returns bytes written to buffer
 size_t kiss_encode_packet(kiss_packet_t p, uint8_t *buffer, size_t buffer_length) {
     if (buffer_length < (p.data_length + 3)) return 0;
+    // Only count escapes when they could make the packet too big
+    if (buffer_length < (p.data_length * 2 + 4) && buffer_length < kiss_encoded_length(&p)) return 0;
+    // Data frames on port 12 have a command byte of FEND, so it is escaped like the data
+    uint8_t command = kiss_encode_command(p.command, p.port);
     buffer[0] = KISS_FRAME_END;
-    buffer[1] = kiss_encode_command(p.command, p.port);
-    size_t len = kiss_encode_data(p.data, p.data_length, buffer + 2, buffer_length - 2) + 2;
+    size_t len = kiss_encode_data(&command, 1, buffer + 1, buffer_length - 1) + 1;
+    len += kiss_encode_data(p.data, p.data_length, buffer + len, buffer_length - len);
     buffer[len++] = KISS_FRAME_END;
     return len;
 }
 
+// Return the number of bytes data will take once escaped
+size_t kiss_escaped_length(const uint8_t *data, size_t data_length) {
+    // One extra byte for each escape
+    size_t len = data_length;
+    size_t i = kiss_find_special(data, data_length);
+    while (i < data_length) {
+        len++;
+        i++;
+        i += kiss_find_special(data + i, data_length - i);
+    }
+    return len;
+}
+
+// Return the number of bytes a packet will take once encoded
+size_t kiss_encoded_length(const kiss_packet_t *p) {
+    // FEND, command, data, FEND
+    uint8_t command = kiss_encode_command(p->command, p->port);
+    return kiss_escaped_length(&command, 1) + kiss_escaped_length(p->data, p->data_length) + 2;
+}
+
+static const uint8_t KISS_FRAME_END_SEQUENCE[] = {KISS_FRAME_END};
+static const uint8_t KISS_ESCAPE_FEND_SEQUENCE[] = {KISS_FRAME_ESCAPE, KISS_ESCAPE_FEND};
+static const uint8_t KISS_ESCAPE_FESC_SEQUENCE[] = {KISS_FRAME_ESCAPE, KISS_ESCAPE_FESC};
+
+// Encode a packet as a list of buffers that reference the packet data
+size_t kiss_encode_packet_iov(const kiss_packet_t *p, uint8_t *header, kiss_iovec_t *iov, size_t iov_count) {
+    size_t n = 0;
+    size_t i = 0;
+
+    if (iov_count < 2) return 0;
+    uint8_t command = kiss_encode_command(p->command, p->port);
+    header[0] = KISS_FRAME_END;
+    iov[n].iov_base = header;
+    iov[n++].iov_len = 1 + kiss_encode_data(&command, 1, header + 1, 2);
+
+    while (i < p->data_length) {
+        size_t run = kiss_next_special(p->data + i, p->data_length - i);
+        if (run > 0) {
+            // Leave room for the closing FEND
+            if (n + 1 >= iov_count) return 0;
+            iov[n].iov_base = p->data + i;
+            iov[n++].iov_len = run;
+            i += run;
+            if (i >= p->data_length) break;
+        }
+        if (n + 1 >= iov_count) return 0;
+        iov[n].iov_base = (void *) ((p->data[i++] == KISS_FRAME_END) ? KISS_ESCAPE_FEND_SEQUENCE : KISS_ESCAPE_FESC_SEQUENCE);
+        iov[n++].iov_len = 2;
+    }
+
+    iov[n].iov_base = (void *) KISS_FRAME_END_SEQUENCE;
+    iov[n++].iov_len = 1;
+    return n;
+}
+
 // Decode a packet, returns bytes consumed from buffer
 size_t kiss_decode_packet(kiss_packet_t *p, uint8_t *buffer, size_t buffer_size) {
     // TODO: Update this to better handle partial packets in the stream
@@ -133,7 +257,15 @@ size_t kiss_decode_packet(kiss_packet_t *p, uint8_t *buffer, size_t buffer_size)
                 // Start of second packet, return early
                 break;
             } else if(!found_packet) {
-                // Start of first packet
+                // Start of first packet, its command byte may be escaped
+                if (b == KISS_FRAME_ESCAPE && i + 1 < buffer_size && buffer[i + 1] != KISS_FRAME_END) {
+                    b = buffer[++i];
+                    if (b == KISS_ESCAPE_FEND) {
+                        b = KISS_FRAME_END;
+                    } else if (b == KISS_ESCAPE_FESC) {
+                        b = KISS_FRAME_ESCAPE;
+                    }
+                }
                 found_packet = 1;
                 packet_data_start = buffer + i + 1;
                 packet_data_length = 0;
@@ -147,6 +279,94 @@ size_t kiss_decode_packet(kiss_packet_t *p, uint8_t *buffer, size_t buffer_size)
     return bytes_consumed;
 }
 
+// Find all frames in a buffer in one pass, returns the number of frames found
+size_t kiss_decode_packets(const uint8_t *buffer, size_t buffer_size, kiss_frame_t *frames, size_t frames_capacity, size_t *resume) {
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i < buffer_size) {
+        // Skip padding, remembering where this frame started
+        size_t frame_start = i;
+        while (i < buffer_size && buffer[i] == KISS_FRAME_END) i++;
+        if (i >= buffer_size) break;
+        if (i > frame_start) frame_start = i - 1;
+        if (count >= frames_capacity) {
+            // Out of room, resume at the start of this frame
+            i = frame_start;
+            break;
+        }
+
+        kiss_frame_t *f = &frames[count++];
+        uint8_t command = buffer[i++];
+        if (command == KISS_FRAME_ESCAPE && i < buffer_size && buffer[i] != KISS_FRAME_END) {
+            // An escaped command byte, as on port 12 data frames
+            command = buffer[i++];
+            if (command == KISS_ESCAPE_FEND) {
+                command = KISS_FRAME_END;
+            } else if (command == KISS_ESCAPE_FESC) {
+                command = KISS_FRAME_ESCAPE;
+            }
+        }
+        kiss_decode_command(command, &(f->command), &(f->port));
+        f->offset = i;
+        f->complete_frame = 0;
+        f->decoded = 0;
+
+        // Each FESC byte shortens the decoded data by one
+        size_t escapes = 0;
+        for (;;) {
+            i += kiss_find_special(buffer + i, buffer_size - i);
+            if (i >= buffer_size || buffer[i] == KISS_FRAME_END) break;
+            escapes++;
+            i++;
+        }
+        f->encoded_length = i - f->offset;
+        f->data_length = f->encoded_length - escapes;
+
+        if (i >= buffer_size) {
+            // Partial frame, resume at its start
+            i = frame_start;
+            break;
+        }
+        f->complete_frame = 1;
+    }
+
+    if (resume) *resume = i;
+    return count;
+}
+
+// Return the decoded data of a frame found by kiss_decode_packets
+uint8_t* kiss_frame_data(uint8_t *buffer, kiss_frame_t *frame) {
+    uint8_t *data = buffer + frame->offset;
+    if (!frame->decoded && frame->data_length != frame->encoded_length) {
+        kiss_decode_data_in_place(data, frame->encoded_length);
+    }
+    frame->decoded = 1;
+    return data;
+}
+
+// Decode a packet without copying, returns bytes consumed from buffer
+size_t kiss_decode_packet_in_place(kiss_packet_t *p, uint8_t *buffer, size_t buffer_size) {
+    kiss_frame_t f;
+    size_t resume = 0;
+    if (kiss_decode_packets(buffer, buffer_size, &f, 1, &resume) == 0 || !f.complete_frame) {
+        // Only padding so far can be dropped, partial packets must stay in the buffer
+        return resume;
+    }
+
+    p->command = f.command;
+    p->port = f.port;
+    p->complete_packet = 1;
+    p->data = kiss_frame_data(buffer, &f);
+    p->data_length = f.data_length;
+    p->data_capacity = f.encoded_length;
+
+    // Consume the closing FEND and any padding after it
+    size_t bytes_consumed = f.offset + f.encoded_length;
+    while (bytes_consumed < buffer_size && buffer[bytes_consumed] == KISS_FRAME_END) bytes_consumed++;
+    return bytes_consumed;
+}
+
 // Create and initialize a packet
 kiss_packet_t kiss_new_packet(uint8_t *data_buffer, size_t data_buffer_size) {
     kiss_packet_t p = {
@@ -168,6 +388,327 @@ void kiss_clear_packet(kiss_packet_t *packet) {
     packet->data_length = 0;
 }
 
+// Create and initialize a streaming decoder
+kiss_decoder_t kiss_new_decoder(uint8_t *data_buffer, size_t data_buffer_size) {
+    kiss_decoder_t d = {
+        .packet = kiss_new_packet(data_buffer, data_buffer_size),
+        .state = KISS_DECODER_IDLE,
+        .filter = 0,
+        .stats = 0,
+        .ax25 = 0,
+        .header_checked = 1,
+        .crc = 0,
+        .crc_type = KISS_CRC_NONE,
+        .crc_value = 0,
+        .fragments = 0,
+        .fragments_context = 0,
+        .fragment_offset = 0
+    };
+    return d;
+}
+
+// Only decode frames whose command bit is set in filter[port]
+void kiss_decoder_set_filter(kiss_decoder_t *decoder, const uint16_t *filter) {
+    decoder->filter = filter;
+}
+
+// Drop data frames by AX.25 address before their payload is copied
+void kiss_decoder_set_ax25_filter(kiss_decoder_t *decoder, const struct kiss_ax25_filter *filter) {
+    decoder->ax25 = filter;
+}
+
+// Check and remove SMACK or FlexNet CRCs
+void kiss_decoder_set_crc(kiss_decoder_t *decoder, struct kiss_crc_link *link) {
+    decoder->crc = link;
+}
+
+// Hand frames too big for the packet buffer to handler a buffer full at a time
+void kiss_decoder_set_fragments(kiss_decoder_t *decoder, kiss_fragment_handler_t handler, void *context) {
+    decoder->fragments = handler;
+    decoder->fragments_context = context;
+}
+
+// Count what the decoder sees in stats
+void kiss_decoder_set_stats(kiss_decoder_t *decoder, struct kiss_stats *stats) {
+    decoder->stats = stats;
+}
+
+// Re-initialize a streaming decoder, discarding any partial packet
+void kiss_clear_decoder(kiss_decoder_t *decoder) {
+    kiss_clear_packet(&decoder->packet);
+    decoder->state = KISS_DECODER_IDLE;
+    decoder->fragment_offset = 0;
+}
+
+#ifndef KISS_NO_STATS
+// Count a complete frame whose final FEND is just before offset i of this push
+static void kiss_stats_frame(kiss_stats_t *stats, const kiss_packet_t *p, size_t len, size_t i) {
+    kiss_decoder_port_stats_t *port = &stats->ports[p->port & 0x0f];
+
+    KISS_STAT_ADD(stats->frames, 1);
+    KISS_STAT_ADD(stats->bytes_out, len);
+    KISS_STAT_ADD(port->frames, 1);
+    KISS_STAT_ADD(port->bytes_in, stats->bytes_in + i - stats->frame_in);
+    KISS_STAT_ADD(port->bytes_out, len);
+    if (len == 0) {
+        KISS_STAT_ADD(stats->empty_frames, 1);
+        KISS_STAT_ADD(port->empty_frames, 1);
+    }
+    if (stats->frame_lost) {
+        KISS_STAT_ADD(stats->truncated, 1);
+        KISS_STAT_ADD(stats->truncated_bytes, stats->frame_lost);
+        KISS_STAT_ADD(port->truncated, 1);
+    }
+    if (stats->histograms) {
+        KISS_STAT_ADD(stats->size_histogram[kiss_stats_bucket(len)], 1);
+        KISS_STAT_ADD(stats->latency_histogram[kiss_stats_bucket(stats->now - stats->frame_start)], 1);
+    }
+}
+
+// Count an escape sequence that was not TFEND or TFESC
+static void kiss_stats_invalid_escape(kiss_stats_t *stats, const kiss_packet_t *p) {
+    KISS_STAT_ADD(stats->invalid_escapes, 1);
+    KISS_STAT_ADD(stats->ports[p->port & 0x0f].invalid_escapes, 1);
+}
+#endif
+
+// Return the kind of CRC a command byte announces on this link
+static inline uint8_t kiss_crc_frame_type(const kiss_crc_link_t *link, uint8_t b) {
+    if (!link || link->mode == KISS_CRC_NONE) return KISS_CRC_NONE;
+    if (link->mode == KISS_CRC_FLEX) return (b & KISS_FLEX_FLAG) ? KISS_CRC_FLEX : KISS_CRC_NONE;
+    return (b & KISS_SMACK_FLAG) ? KISS_CRC_SMACK : KISS_CRC_NONE;
+}
+
+// Add decoded bytes to the CRC of the current frame
+static inline uint16_t kiss_crc_update(uint8_t type, uint16_t crc, const uint8_t *data, size_t length) {
+    return (type == KISS_CRC_SMACK) ? kiss_crc16(crc, data, length) : kiss_crc_flex(crc, data, length);
+}
+
+// Check and strip the CRC at the end of a frame, returns 0 if the frame must be dropped
+static int kiss_crc_end(kiss_crc_link_t *link, uint8_t type, uint16_t crc, const kiss_packet_t *p, size_t *len) {
+    if (type == KISS_CRC_NONE) {
+        // A plain data frame means the other end of this port does not speak SMACK
+        if (link->mode == KISS_CRC_AUTO && p->command == KISS_DATA_FRAME && p->port < KISS_SMACK_PORTS) {
+            link->smack[p->port] = 0;
+        }
+        return 1;
+    }
+    if (*len < 2 || crc != ((type == KISS_CRC_SMACK) ? 0 : KISS_FLEX_RESIDUE)) {
+        link->bad++;
+        return 0;
+    }
+    *len -= 2;
+    link->good++;
+    if (type == KISS_CRC_SMACK) link->smack[p->port] = 1;
+    return 1;
+}
+
+// Hand a piece of the current frame to the fragment handler. The last keep bytes stay
+// behind in the buffer, they may turn out to be the CRC. Returns the bytes left in the buffer.
+static size_t kiss_decoder_fragment(kiss_decoder_t *d, size_t len, size_t keep, uint8_t end, kiss_fragment_status_t status) {
+    kiss_packet_t *p = &d->packet;
+    kiss_fragment_t f = {
+        .command = p->command,
+        .port = p->port,
+        .end = end,
+        .status = status,
+        .data = p->data,
+        .length = len - keep,
+        .offset = d->fragment_offset,
+        .total = d->fragment_offset + len - keep
+    };
+    d->fragments(&f, d->fragments_context);
+    d->fragment_offset += len - keep;
+    memmove(p->data, p->data + len - keep, keep);
+    return keep;
+}
+
+// Feed bytes to a streaming decoder, returns bytes consumed from buffer
+size_t kiss_decoder_push(kiss_decoder_t *d, const uint8_t *buffer, size_t buffer_size) {
+    kiss_packet_t *p = &d->packet;
+    kiss_decoder_state_t state = d->state;
+    size_t len = p->data_length;
+    size_t i = 0;
+    size_t run, copy;
+    const uint8_t *skip;
+    uint8_t checked = d->header_checked;
+    uint8_t crc_type = d->crc_type;
+    uint16_t crc = d->crc_value;
+    size_t hold = d->crc_type ? 2 : 0;
+    int keep;
+#ifndef KISS_NO_STATS
+    kiss_stats_t *stats = d->stats;
+#endif
+
+    if (p->complete_packet) {
+        // The previous packet was handed to the caller, start over
+        kiss_clear_packet(p);
+        len = 0;
+    }
+
+    while (i < buffer_size) {
+        uint8_t b = buffer[i++];
+        if (b == KISS_FRAME_END) {
+            if (state == KISS_DECODER_DATA || state == KISS_DECODER_ESCAPE) {
+                if (state == KISS_DECODER_ESCAPE) KISS_STAT(kiss_stats_invalid_escape(stats, p));
+                state = KISS_DECODER_COMMAND;
+                if (d->crc && !kiss_crc_end(d->crc, crc_type, crc, p, &len)) {
+                    KISS_STAT(KISS_STAT_ADD(stats->crc_errors, 1));
+                    if (d->fragment_offset) kiss_decoder_fragment(d, 0, 0, 1, KISS_FRAGMENT_BAD_CRC);
+                    len = 0;
+                    continue;
+                }
+                if (d->fragment_offset) {
+                    // The rest of a frame that was too big for the buffer
+                    KISS_STAT(kiss_stats_frame(stats, p, d->fragment_offset + len, i));
+                    len = kiss_decoder_fragment(d, len, 0, 1, KISS_FRAGMENT_OK);
+                    continue;
+                }
+                if (!checked && kiss_ax25_filter_check(d->ax25, p->data, len, 1) == 0) {
+                    // Too short for the filter to accept
+                    KISS_STAT(KISS_STAT_ADD(stats->filtered_frames, 1); KISS_STAT_ADD(stats->filtered_bytes, len + 2));
+                    len = 0;
+                    continue;
+                }
+                // End of packet
+                p->complete_packet = 1;
+                p->data_length = len;
+                KISS_STAT(kiss_stats_frame(stats, p, len, i));
+                break;
+            }
+            // Padding or start of packet
+            state = KISS_DECODER_COMMAND;
+            continue;
+        }
+        switch (state) {
+            case KISS_DECODER_IDLE:
+            case KISS_DECODER_SKIP:
+                // Not in a frame we want, skip ahead to the next FEND
+                skip = memchr(buffer + i, KISS_FRAME_END, buffer_size - i);
+                run = (skip ? (size_t) (skip - buffer) : buffer_size) - i + 1;
+                if (state == KISS_DECODER_IDLE) {
+                    KISS_STAT(KISS_STAT_ADD(stats->dropped_bytes, run));
+                } else {
+                    KISS_STAT(KISS_STAT_ADD(stats->filtered_bytes, run));
+                }
+                i += run - 1;
+                continue;
+            case KISS_DECODER_COMMAND_ESCAPE:
+                if (b == KISS_ESCAPE_FEND) {
+                    b = KISS_FRAME_END;
+                } else if (b == KISS_ESCAPE_FESC) {
+                    b = KISS_FRAME_ESCAPE;
+                }
+                // fall through
+            case KISS_DECODER_COMMAND:
+                // SMACK port 4 data frames have a command byte of FEND, so it arrives escaped
+                if (b == KISS_FRAME_ESCAPE && state == KISS_DECODER_COMMAND) {
+                    KISS_STAT(stats->frame_in = stats->bytes_in + i - 1);
+                    state = KISS_DECODER_COMMAND_ESCAPE;
+                    continue;
+                }
+                crc_type = kiss_crc_frame_type(d->crc, b);
+                if (crc_type == KISS_CRC_SMACK) {
+                    crc = kiss_crc16(0, &b, 1);
+                    b &= ~KISS_SMACK_FLAG;
+                } else if (crc_type == KISS_CRC_FLEX) {
+                    crc = kiss_crc_flex(0xFFFF, &b, 1);
+                    b &= ~KISS_FLEX_FLAG;
+                }
+                if (d->filter && !(d->filter[b >> 4] & (1 << (b & 0x0f)))) {
+                    // Nobody wants this frame, skip it without decoding
+                    KISS_STAT(KISS_STAT_ADD(stats->filtered_frames, 1); KISS_STAT_ADD(stats->filtered_bytes, 1));
+                    state = KISS_DECODER_SKIP;
+                    continue;
+                }
+                kiss_decode_command(b, &(p->command), &(p->port));
+                d->fragment_offset = 0;
+                // A CRC is held back from each fragment until the frame ends
+                hold = crc_type ? 2 : 0;
+                KISS_STAT(stats->frame_start = stats->now; stats->frame_lost = 0);
+                // stats->bytes_in is only brought up to date at the end of the push
+                if (state == KISS_DECODER_COMMAND) KISS_STAT(stats->frame_in = stats->bytes_in + i - 1);
+                checked = !(d->ax25 && p->command == KISS_DATA_FRAME);
+                state = KISS_DECODER_DATA;
+                continue;
+            case KISS_DECODER_ESCAPE:
+                if (b == KISS_ESCAPE_FEND) {
+                    b = KISS_FRAME_END;
+                } else if (b == KISS_ESCAPE_FESC) {
+                    b = KISS_FRAME_ESCAPE;
+                } else {
+                    KISS_STAT(kiss_stats_invalid_escape(stats, p));
+                    if (b == KISS_FRAME_ESCAPE) continue;
+                }
+                state = KISS_DECODER_DATA;
+                if (crc_type) crc = kiss_crc_update(crc_type, crc, &b, 1);
+                if (d->fragments && len == p->data_capacity && len > hold) {
+                    len = kiss_decoder_fragment(d, len, hold, 0, KISS_FRAGMENT_OK);
+                }
+                if (len < p->data_capacity) {
+                    p->data[len++] = b;
+                } else {
+                    KISS_STAT(stats->frame_lost++);
+                }
+                break;
+            case KISS_DECODER_DATA:
+                if (b == KISS_FRAME_ESCAPE) {
+                    KISS_STAT(KISS_STAT_ADD(stats->escapes, 1); KISS_STAT_ADD(stats->ports[p->port & 0x0f].escapes, 1));
+                    state = KISS_DECODER_ESCAPE;
+                    continue;
+                }
+                // Copy this byte and everything up to the next FEND or FESC in one go
+                run = kiss_next_special(buffer + i, buffer_size - i) + 1;
+                if (!checked) {
+                    // Until the AX.25 filter has decided, copy no further than the address field
+                    if (run > KISS_AX25_MAX_HEADER - len) run = KISS_AX25_MAX_HEADER - len;
+                    // and nothing that would have to be streamed
+                    if (d->fragments && run > p->data_capacity - len) run = p->data_capacity - len;
+                }
+                copy = (run < p->data_capacity - len) ? run : p->data_capacity - len;
+                memcpy(p->data + len, buffer + i - 1, copy);
+                // The CRC covers the whole run, including anything lost to truncation
+                if (crc_type) crc = kiss_crc_update(crc_type, crc, buffer + i - 1, run);
+                len += copy;
+                while (copy < run && d->fragments && len > hold) {
+                    // The buffer is full, pass it on and carry on copying
+                    len = kiss_decoder_fragment(d, len, hold, 0, KISS_FRAGMENT_OK);
+                    size_t more = (run - copy < p->data_capacity - len) ? run - copy : p->data_capacity - len;
+                    memcpy(p->data + len, buffer + i - 1 + copy, more);
+                    len += more;
+                    copy += more;
+                }
+                if (copy < run) KISS_STAT(stats->frame_lost += run - copy);
+                i += run - 1;
+                break;
+        }
+        if (!checked) {
+            keep = kiss_ax25_filter_check(d->ax25, p->data, len, len >= p->data_capacity);
+            if (keep == 0) {
+                // Rejected by address, skip the payload without copying it
+                KISS_STAT(KISS_STAT_ADD(stats->filtered_frames, 1); KISS_STAT_ADD(stats->filtered_bytes, len + 2));
+                state = KISS_DECODER_SKIP;
+                len = 0;
+            }
+            checked = (keep == 1);
+        }
+    }
+
+    p->data_length = len;
+    d->state = state;
+    d->header_checked = checked;
+    d->crc_type = crc_type;
+    d->crc_value = crc;
+    KISS_STAT(KISS_STAT_ADD(stats->bytes_in, i));
+    return i;
+}
+
+// Feed a single byte to a streaming decoder, returns 1 if a packet was completed
+uint8_t kiss_decoder_push_byte(kiss_decoder_t *decoder, uint8_t b) {
+    kiss_decoder_push(decoder, &b, 1);
+    return decoder->packet.complete_packet;
+}
+
 // Return a human readable name for a command
 const char* kiss_command_name(kiss_command_t command) {
     switch (command) {
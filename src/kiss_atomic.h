@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+/**
+ * Loads and stores for size_t indexes shared between a producer and a consumer.
+ *
+ * The producer publishes data with a release store of its index, and the
+ * consumer reads the index with an acquire load before touching the data.
+ * Compilers without the GCC atomic builtins fall back to volatile accesses,
+ * which is enough for a single core with interrupts. Compare and exchange is
+ * only available with the builtins, and fences and the spin lock are no-ops
+ * without them, so anything that relies on the lock is single threaded there.
+ */
+
+#if defined(__GNUC__)
+#define KISS_LOAD_ACQUIRE(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define KISS_LOAD_RELAXED(p)        __atomic_load_n((p), __ATOMIC_RELAXED)
+#define KISS_STORE_RELEASE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define KISS_STORE_RELAXED(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define KISS_COMPARE_EXCHANGE(p, expected, desired) \
+    __atomic_compare_exchange_n((p), (expected), (desired), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define KISS_FETCH_ADD(p, v)        __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define KISS_FETCH_SUB(p, v)        __atomic_fetch_sub((p), (v), __ATOMIC_ACQ_REL)
+#define KISS_FENCE_ACQUIRE()        __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define KISS_FENCE_RELEASE()        __atomic_thread_fence(__ATOMIC_RELEASE)
+#define KISS_FENCE()                __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define KISS_LOCK(p)                while (__atomic_test_and_set((p), __ATOMIC_ACQUIRE))
+#define KISS_UNLOCK(p)              __atomic_clear((p), __ATOMIC_RELEASE)
+#else
+#define KISS_LOAD_ACQUIRE(p)        (*(volatile size_t *) (p))
+#define KISS_LOAD_RELAXED(p)        (*(volatile size_t *) (p))
+#define KISS_STORE_RELEASE(p, v)    (*(volatile size_t *) (p) = (v))
+#define KISS_STORE_RELAXED(p, v)    (*(volatile size_t *) (p) = (v))
+#define KISS_FETCH_ADD(p, v)        ((*(volatile size_t *) (p) += (v)) - (v))
+#define KISS_FETCH_SUB(p, v)        ((*(volatile size_t *) (p) -= (v)) + (v))
+#define KISS_FENCE_ACQUIRE()
+#define KISS_FENCE_RELEASE()
+#define KISS_FENCE()
+#define KISS_LOCK(p)                (void) (p)
+#define KISS_UNLOCK(p)              (void) (p)
+#endif
@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_ax25.h"
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static size_t kiss_ax25_hash(const uint8_t *callsign) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        hash ^= callsign[i];
+        hash *= 16777619u;
+    }
+    return hash & (KISS_AX25_FILTER_SLOTS - 1);
+}
+
+// Return the entry for a callsign, or the empty slot where it belongs
+static kiss_ax25_filter_entry_t* kiss_ax25_find(const kiss_ax25_filter_t *filter, const uint8_t *callsign) {
+    size_t i = kiss_ax25_hash(callsign);
+    while (filter->slots[i].used && memcmp(filter->slots[i].callsign, callsign, 6) != 0) {
+        i = (i + 1) & (KISS_AX25_FILTER_SLOTS - 1);
+    }
+    return (kiss_ax25_filter_entry_t *) &filter->slots[i];
+}
+
+// Initialize an empty filter
+void kiss_ax25_filter_init(kiss_ax25_filter_t *filter, kiss_ax25_mode_t mode) {
+    memset(filter, 0, sizeof(*filter));
+    filter->mode = mode;
+}
+
+// Add a callsign such as "N0CALL", "N0CALL-7" or "N0CALL-*" for any SSID
+int kiss_ax25_filter_add(kiss_ax25_filter_t *filter, const char *callsign, uint8_t fields) {
+    uint8_t shifted[6];
+    size_t i = 0;
+    for (; i < 6 && callsign[i] && callsign[i] != '-'; i++) {
+        char c = callsign[i];
+        if (c >= 'a' && c <= 'z') c = (char) (c - 'a' + 'A');
+        if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) return -1;
+        shifted[i] = (uint8_t) (c << 1);
+    }
+    if (i == 0 || (callsign[i] && callsign[i] != '-')) return -1;
+    for (size_t j = i; j < 6; j++) shifted[j] = ' ' << 1;
+
+    uint16_t ssids = 1;
+    if (callsign[i] == '-') {
+        const char *s = callsign + i + 1;
+        if (s[0] == '*' && s[1] == 0) {
+            ssids = 0xffff;
+        } else {
+            int ssid = 0;
+            if (!*s) return -1;
+            for (; *s; s++) {
+                if (*s < '0' || *s > '9') return -1;
+                ssid = ssid * 10 + (*s - '0');
+            }
+            if (ssid > 15) return -1;
+            ssids = (uint16_t) (1 << ssid);
+        }
+    }
+
+    kiss_ax25_filter_entry_t *entry = kiss_ax25_find(filter, shifted);
+    if (!entry->used) {
+        if (filter->count >= KISS_AX25_FILTER_SLOTS / 2) return -1;
+        memcpy(entry->callsign, shifted, 6);
+        entry->used = 1;
+        filter->count++;
+    }
+    for (int f = 0; f < 3; f++) {
+        if (fields & (1 << f)) entry->ssids[f] |= ssids;
+    }
+    return 0;
+}
+
+// Check the start of a data frame
+int kiss_ax25_filter_check(const kiss_ax25_filter_t *filter, const uint8_t *data, size_t length, uint8_t complete) {
+    uint8_t keep_on_match = (filter->mode == KISS_AX25_ACCEPT);
+    for (size_t n = 0; n < KISS_AX25_MAX_ADDRESSES; n++) {
+        const uint8_t *address = data + n * KISS_AX25_ADDRESS_SIZE;
+        if ((n + 1) * KISS_AX25_ADDRESS_SIZE > length) {
+            // Not enough address bytes yet, or not AX.25 at all
+            if (!complete) return -1;
+            return !keep_on_match;
+        }
+        size_t field = (n < 2) ? n : 2;
+        if (filter->count) {
+            const kiss_ax25_filter_entry_t *entry = kiss_ax25_find(filter, address);
+            // One match decides the frame, the rest of the addresses do not matter
+            if (entry->used && (entry->ssids[field] & (1 << ((address[6] >> 1) & 0x0f)))) return keep_on_match;
+        }
+        // The extension bit marks the last address, which is at least the source
+        if (n > 0 && (address[6] & 1)) break;
+    }
+    return !keep_on_match;
+}
+
+#ifdef __cplusplus
+}
+#endif
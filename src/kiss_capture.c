@@ -0,0 +1,494 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_capture.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static void kiss_put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t) (v >> (8 * i));
+}
+
+static void kiss_put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t) (v >> (8 * i));
+}
+
+static uint32_t kiss_get_u32(const uint8_t *p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t kiss_get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+// FNV-1a, enough to notice a block that was only partly written
+static uint32_t kiss_capture_checksum(const uint8_t *data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Write all of a buffer at an offset
+static int kiss_capture_pwrite(int fd, const uint8_t *data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t n = pwrite(fd, data, length, (off_t) offset);
+        if (n <= 0) return -1;
+        data += n;
+        length -= (size_t) n;
+        offset += (uint64_t) n;
+    }
+    return 0;
+}
+
+// Add an entry to a growing index
+static int kiss_capture_index_add(kiss_capture_index_entry_t **index, size_t *count, size_t *capacity, const kiss_capture_index_entry_t *entry) {
+    if (*count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 64;
+        kiss_capture_index_entry_t *p = realloc(*index, grown * sizeof(kiss_capture_index_entry_t));
+        if (!p) return -1;
+        *index = p;
+        *capacity = grown;
+    }
+    (*index)[(*count)++] = *entry;
+    return 0;
+}
+
+static int kiss_capture_check_header(const uint8_t *map, size_t size) {
+    if (size < KISS_CAPTURE_HEADER_SIZE || memcmp(map, KISS_CAPTURE_MAGIC, 8) != 0) return -1;
+    return (kiss_get_u32(map + 8) == KISS_CAPTURE_VERSION) ? 0 : -1;
+}
+
+// Load the index pointed to by the footer, returns 0 or -1 if there is no valid footer
+static int kiss_capture_read_footer(const uint8_t *map, size_t size, kiss_capture_index_entry_t **index, size_t *count, uint64_t *frames) {
+    if (size < KISS_CAPTURE_HEADER_SIZE + KISS_CAPTURE_FOOTER_SIZE) return -1;
+    const uint8_t *footer = map + size - KISS_CAPTURE_FOOTER_SIZE;
+    uint64_t index_offset = kiss_get_u64(footer);
+    uint64_t entries = kiss_get_u64(footer + 8);
+    if (kiss_get_u32(footer + 24) != KISS_CAPTURE_FOOTER_MAGIC) return -1;
+    if (index_offset < KISS_CAPTURE_HEADER_SIZE || entries > size / KISS_CAPTURE_INDEX_ENTRY_SIZE ||
+            index_offset + entries * KISS_CAPTURE_INDEX_ENTRY_SIZE != size - KISS_CAPTURE_FOOTER_SIZE) return -1;
+    const uint8_t *p = map + index_offset;
+    if (kiss_capture_checksum(p, entries * KISS_CAPTURE_INDEX_ENTRY_SIZE) != kiss_get_u32(footer + 28)) return -1;
+
+    kiss_capture_index_entry_t *entry = malloc((entries ? entries : 1) * sizeof(kiss_capture_index_entry_t));
+    if (!entry) return -1;
+    uint64_t end = KISS_CAPTURE_HEADER_SIZE;
+    for (size_t i = 0; i < entries; i++, p += KISS_CAPTURE_INDEX_ENTRY_SIZE) {
+        entry[i].first_time = kiss_get_u64(p);
+        entry[i].last_time = kiss_get_u64(p + 8);
+        entry[i].offset = kiss_get_u64(p + 16);
+        entry[i].records = kiss_get_u32(p + 24);
+        entry[i].length = kiss_get_u32(p + 28);
+        // Blocks must be in order, not overlap, and lie between the header and the index
+        if (entry[i].offset < end || entry[i].offset > index_offset || index_offset - entry[i].offset < KISS_CAPTURE_BLOCK_HEADER_SIZE ||
+                entry[i].length > index_offset - entry[i].offset - KISS_CAPTURE_BLOCK_HEADER_SIZE) {
+            free(entry);
+            return -1;
+        }
+        end = entry[i].offset + KISS_CAPTURE_BLOCK_HEADER_SIZE + entry[i].length;
+    }
+    *index = entry;
+    *count = entries;
+    *frames = kiss_get_u64(footer + 16);
+    return 0;
+}
+
+// Index the blocks of a file without a footer, returns the offset just past the last good block
+static uint64_t kiss_capture_scan(const uint8_t *map, size_t size, kiss_capture_index_entry_t **index, size_t *count, size_t *capacity, uint64_t *frames) {
+    uint64_t offset = KISS_CAPTURE_HEADER_SIZE;
+    while (offset + KISS_CAPTURE_BLOCK_HEADER_SIZE <= size) {
+        const uint8_t *h = map + offset;
+        kiss_capture_index_entry_t entry = {
+            .first_time = kiss_get_u64(h + 8),
+            .last_time = kiss_get_u64(h + 16),
+            .offset = offset,
+            .records = kiss_get_u32(h + 4),
+            .length = kiss_get_u32(h + 24)
+        };
+        if (kiss_get_u32(h) != KISS_CAPTURE_BLOCK_MAGIC) break;
+        if (entry.length > size - offset - KISS_CAPTURE_BLOCK_HEADER_SIZE) break;
+        if (kiss_capture_checksum(h + KISS_CAPTURE_BLOCK_HEADER_SIZE, entry.length) != kiss_get_u32(h + 28)) break;
+        if (kiss_capture_index_add(index, count, capacity, &entry) < 0) break;
+        *frames += entry.records;
+        offset += KISS_CAPTURE_BLOCK_HEADER_SIZE + entry.length;
+    }
+    return offset;
+}
+
+// Return the current time in nanoseconds since the epoch
+uint64_t kiss_capture_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t) t.tv_sec * 1000000000u + (uint64_t) t.tv_nsec;
+}
+
+static int kiss_capture_init_writer(kiss_capture_writer_t *writer, int fd, size_t block_size) {
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = fd;
+    writer->block_size = block_size ? block_size : KISS_CAPTURE_BLOCK_SIZE;
+    writer->block_capacity = writer->block_size;
+    // Room for the block header in front of the records, so a block is one write
+    writer->block = malloc(KISS_CAPTURE_BLOCK_HEADER_SIZE + writer->block_capacity);
+    return writer->block ? 0 : -1;
+}
+
+// Create a new capture file, replacing any existing one
+int kiss_capture_create(kiss_capture_writer_t *writer, const char *path, size_t block_size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    uint8_t header[KISS_CAPTURE_HEADER_SIZE] = {0};
+    memcpy(header, KISS_CAPTURE_MAGIC, 8);
+    kiss_put_u32(header + 8, KISS_CAPTURE_VERSION);
+    kiss_put_u32(header + 12, (uint32_t) (block_size ? block_size : KISS_CAPTURE_BLOCK_SIZE));
+    if (kiss_capture_init_writer(writer, fd, block_size) < 0 ||
+            kiss_capture_pwrite(fd, header, sizeof(header), 0) < 0) {
+        free(writer->block);
+        close(fd);
+        return -1;
+    }
+    writer->offset = KISS_CAPTURE_HEADER_SIZE;
+    return 0;
+}
+
+// Open a capture file to add to it, creating it if needed and recovering a truncated tail
+int kiss_capture_append(kiss_capture_writer_t *writer, const char *path, size_t block_size) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return kiss_capture_create(writer, path, block_size);
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size < KISS_CAPTURE_HEADER_SIZE) {
+        // Not even the header made it to disk
+        close(fd);
+        return kiss_capture_create(writer, path, block_size);
+    }
+    uint8_t *map = mmap(0, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED || kiss_capture_check_header(map, (size_t) st.st_size) < 0 ||
+            kiss_capture_init_writer(writer, fd, block_size) < 0) {
+        if (map != MAP_FAILED) munmap(map, (size_t) st.st_size);
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t) st.st_size;
+    if (kiss_capture_read_footer(map, size, &writer->index, &writer->index_count, &writer->frames) == 0) {
+        // New blocks replace the old index and footer
+        writer->index_capacity = writer->index_count;
+        writer->offset = (writer->index_count > 0) ?
+            writer->index[writer->index_count - 1].offset + KISS_CAPTURE_BLOCK_HEADER_SIZE + writer->index[writer->index_count - 1].length :
+            KISS_CAPTURE_HEADER_SIZE;
+    } else {
+        writer->offset = kiss_capture_scan(map, size, &writer->index, &writer->index_count, &writer->index_capacity, &writer->frames);
+    }
+    munmap(map, size);
+    if (writer->index_count > 0) writer->last_time = writer->index[writer->index_count - 1].last_time;
+
+    // Cut off whatever follows the last good block
+    if (ftruncate(fd, (off_t) writer->offset) < 0) {
+        free(writer->block);
+        free(writer->index);
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+// Fill in the header of the current block, returns its index entry
+static kiss_capture_index_entry_t kiss_capture_seal_block(kiss_capture_writer_t *writer) {
+    kiss_capture_index_entry_t entry = {
+        .first_time = writer->block_first,
+        .last_time = writer->last_time,
+        .offset = writer->offset,
+        .records = writer->block_records,
+        .length = (uint32_t) writer->block_length
+    };
+    uint8_t *h = writer->block;
+    kiss_put_u32(h, KISS_CAPTURE_BLOCK_MAGIC);
+    kiss_put_u32(h + 4, entry.records);
+    kiss_put_u64(h + 8, entry.first_time);
+    kiss_put_u64(h + 16, entry.last_time);
+    kiss_put_u32(h + 24, entry.length);
+    kiss_put_u32(h + 28, kiss_capture_checksum(h + KISS_CAPTURE_BLOCK_HEADER_SIZE, writer->block_length));
+    return entry;
+}
+
+// Write out the current block so it survives a crash
+int kiss_capture_flush(kiss_capture_writer_t *writer) {
+    if (writer->block_records == 0) return 0;
+    kiss_capture_index_entry_t entry = kiss_capture_seal_block(writer);
+
+    size_t length = KISS_CAPTURE_BLOCK_HEADER_SIZE + writer->block_length;
+    if (kiss_capture_pwrite(writer->fd, writer->block, length, writer->offset) < 0) return -1;
+    if (kiss_capture_index_add(&writer->index, &writer->index_count, &writer->index_capacity, &entry) < 0) return -1;
+    writer->offset += length;
+    writer->block_length = 0;
+    writer->block_records = 0;
+    if (writer->block_capacity > writer->block_size) {
+        // That was a frame bigger than a block, go back to the usual size
+        uint8_t *block = realloc(writer->block, KISS_CAPTURE_BLOCK_HEADER_SIZE + writer->block_size);
+        if (block) writer->block = block;
+        writer->block_capacity = writer->block_size;
+    }
+    return 0;
+}
+
+// Finish the current block and hand it over to be written by the caller
+int kiss_capture_take_block(kiss_capture_writer_t *writer, uint8_t **block, size_t *length, kiss_capture_index_entry_t *entry) {
+    if (writer->block_records == 0) return 0;
+    // The next block goes into the spare buffer, or a new one
+    uint8_t *next = writer->spare ? writer->spare : malloc(KISS_CAPTURE_BLOCK_HEADER_SIZE + writer->block_size);
+    if (!next) return -1;
+    // The block joins the index and the frame count once it has been written
+    *entry = kiss_capture_seal_block(writer);
+    writer->frames -= entry->records;
+
+    *block = writer->block;
+    *length = KISS_CAPTURE_BLOCK_HEADER_SIZE + writer->block_length;
+    writer->spare = 0;
+    writer->block = next;
+    writer->block_capacity = writer->block_size;
+    writer->offset += *length;
+    writer->block_length = 0;
+    writer->block_records = 0;
+    return 1;
+}
+
+// Add a block from kiss_capture_take_block to the index once it has been written
+int kiss_capture_add_block(kiss_capture_writer_t *writer, const kiss_capture_index_entry_t *entry) {
+    if (kiss_capture_index_add(&writer->index, &writer->index_count, &writer->index_capacity, entry) < 0) return -1;
+    // Writes can finish out of order, keep the index sorted by offset
+    size_t i = writer->index_count - 1;
+    while (i > 0 && writer->index[i - 1].offset > entry->offset) {
+        writer->index[i] = writer->index[i - 1];
+        i--;
+    }
+    writer->index[i] = *entry;
+    writer->frames += entry->records;
+    return 0;
+}
+
+// Give back a block from kiss_capture_take_block once it has been written, or has failed to be
+void kiss_capture_return_block(kiss_capture_writer_t *writer, uint8_t *block) {
+    if (writer->spare) {
+        free(block);
+    } else {
+        writer->spare = block;
+    }
+}
+
+// Record a frame
+int kiss_capture_write(kiss_capture_writer_t *writer, uint64_t timestamp, const kiss_packet_t *packet) {
+    size_t length = KISS_CAPTURE_RECORD_HEADER_SIZE + packet->data_length;
+    if (writer->block_length + length > writer->block_capacity) {
+        if (kiss_capture_flush(writer) < 0) return -1;
+        if (length > writer->block_capacity) {
+            // A frame bigger than a block gets a block of its own
+            uint8_t *block = realloc(writer->block, KISS_CAPTURE_BLOCK_HEADER_SIZE + length);
+            if (!block) return -1;
+            writer->block = block;
+            writer->block_capacity = length;
+        }
+    }
+
+    // Keep time moving forward so seeks can binary search
+    if (timestamp < writer->last_time) timestamp = writer->last_time;
+    if (writer->block_records == 0) writer->block_first = timestamp;
+    writer->last_time = timestamp;
+
+    uint8_t *r = writer->block + KISS_CAPTURE_BLOCK_HEADER_SIZE + writer->block_length;
+    kiss_put_u64(r, timestamp);
+    kiss_put_u32(r + 8, (uint32_t) packet->data_length);
+    r[12] = (uint8_t) packet->command;
+    r[13] = packet->port;
+    r[14] = 0;
+    r[15] = 0;
+    memcpy(r + KISS_CAPTURE_RECORD_HEADER_SIZE, packet->data, packet->data_length);
+    writer->block_length += length;
+    writer->block_records++;
+    writer->frames++;
+    return 0;
+}
+
+// Write out the current block, the index and the footer, and close the file
+int kiss_capture_close(kiss_capture_writer_t *writer) {
+    int result = kiss_capture_flush(writer);
+
+    size_t index_length = writer->index_count * KISS_CAPTURE_INDEX_ENTRY_SIZE;
+    uint8_t *tail = malloc(index_length + KISS_CAPTURE_FOOTER_SIZE);
+    if (result == 0 && tail) {
+        uint8_t *p = tail;
+        for (size_t i = 0; i < writer->index_count; i++, p += KISS_CAPTURE_INDEX_ENTRY_SIZE) {
+            kiss_put_u64(p, writer->index[i].first_time);
+            kiss_put_u64(p + 8, writer->index[i].last_time);
+            kiss_put_u64(p + 16, writer->index[i].offset);
+            kiss_put_u32(p + 24, writer->index[i].records);
+            kiss_put_u32(p + 28, writer->index[i].length);
+        }
+        kiss_put_u64(p, writer->offset);
+        kiss_put_u64(p + 8, writer->index_count);
+        kiss_put_u64(p + 16, writer->frames);
+        kiss_put_u32(p + 24, KISS_CAPTURE_FOOTER_MAGIC);
+        kiss_put_u32(p + 28, kiss_capture_checksum(tail, index_length));
+        if (kiss_capture_pwrite(writer->fd, tail, index_length + KISS_CAPTURE_FOOTER_SIZE, writer->offset) < 0) result = -1;
+    } else {
+        result = -1;
+    }
+    if (fsync(writer->fd) < 0) result = -1;
+    if (close(writer->fd) < 0) result = -1;
+
+    free(tail);
+    free(writer->block);
+    free(writer->spare);
+    free(writer->index);
+    writer->block = 0;
+    writer->spare = 0;
+    writer->index = 0;
+    writer->fd = -1;
+    return result;
+}
+
+// Move the reader to the start of a block
+static void kiss_capture_enter_block(kiss_capture_reader_t *reader, size_t block) {
+    reader->block = block;
+    if (block < reader->index_count) {
+        reader->position = reader->index[block].offset + KISS_CAPTURE_BLOCK_HEADER_SIZE;
+        reader->block_end = reader->position + reader->index[block].length;
+    } else {
+        reader->position = 0;
+        reader->block_end = 0;
+    }
+}
+
+// Map a capture file for reading
+int kiss_capture_open(kiss_capture_reader_t *reader, const char *path) {
+    memset(reader, 0, sizeof(*reader));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < KISS_CAPTURE_HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+    // A private writable mapping lets callers decode frames in place without touching the file
+    uint8_t *map = mmap(0, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    reader->map = map;
+    reader->size = (size_t) st.st_size;
+    if (kiss_capture_check_header(map, reader->size) < 0) {
+        kiss_capture_close_reader(reader);
+        return -1;
+    }
+
+    if (kiss_capture_read_footer(map, reader->size, &reader->index, &reader->index_count, &reader->frames) < 0) {
+        size_t capacity = 0;
+        kiss_capture_scan(map, reader->size, &reader->index, &reader->index_count, &capacity, &reader->frames);
+        reader->recovered = 1;
+    }
+    kiss_capture_enter_block(reader, 0);
+    return 0;
+}
+
+// Position the reader at the first frame at or after timestamp
+int kiss_capture_seek(kiss_capture_reader_t *reader, uint64_t timestamp) {
+    // Find the first block that ends at or after timestamp
+    size_t low = 0, high = reader->index_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (reader->index[middle].last_time < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    kiss_capture_enter_block(reader, low);
+    if (low == reader->index_count) return -1;
+
+    // Then the first record in it
+    while (reader->position + KISS_CAPTURE_RECORD_HEADER_SIZE <= reader->block_end) {
+        const uint8_t *r = reader->map + reader->position;
+        if (kiss_get_u64(r) >= timestamp) return 0;
+        reader->position += KISS_CAPTURE_RECORD_HEADER_SIZE + kiss_get_u32(r + 8);
+    }
+    return 0;
+}
+
+// Return the next frame, with data pointing into the file
+int kiss_capture_next(kiss_capture_reader_t *reader, uint64_t *timestamp, kiss_packet_t *packet) {
+    while (reader->position + KISS_CAPTURE_RECORD_HEADER_SIZE > reader->block_end) {
+        if (reader->block >= reader->index_count) return 0;
+        kiss_capture_enter_block(reader, reader->block + 1);
+    }
+    uint8_t *r = reader->map + reader->position;
+    size_t length = kiss_get_u32(r + 8);
+    if (length > reader->block_end - reader->position - KISS_CAPTURE_RECORD_HEADER_SIZE) {
+        // A damaged record, skip the rest of the block
+        reader->position = reader->block_end;
+        return kiss_capture_next(reader, timestamp, packet);
+    }
+    if (timestamp) *timestamp = kiss_get_u64(r);
+    packet->command = (kiss_command_t) r[12];
+    packet->port = r[13];
+    packet->data = r + KISS_CAPTURE_RECORD_HEADER_SIZE;
+    packet->data_length = length;
+    packet->data_capacity = length;
+    packet->complete_packet = 1;
+    reader->position += KISS_CAPTURE_RECORD_HEADER_SIZE + length;
+    return 1;
+}
+
+// Unmap the file and release the index
+void kiss_capture_close_reader(kiss_capture_reader_t *reader) {
+    if (reader->map) munmap(reader->map, reader->size);
+    free(reader->index);
+    reader->map = 0;
+    reader->index = 0;
+    reader->index_count = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __unix__ || __APPLE__
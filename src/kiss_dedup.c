@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_dedup.h"
+#include "kiss_ax25.h"
+
+#include <string.h>
+
+#define KISS_DEDUP_MULTIPLIER   0x9E3779B97F4A7C15ULL
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Initialize with entry_count entries, a power of two and at least KISS_DEDUP_WAYS
+int kiss_dedup_init(kiss_dedup_t *dedup, kiss_dedup_entry_t *entries, size_t entry_count, uint64_t window, uint8_t ignore_path) {
+    memset(dedup, 0, sizeof(*dedup));
+    if (entry_count < KISS_DEDUP_WAYS || (entry_count & (entry_count - 1)) != 0) return -1;
+    dedup->entries = entries;
+    dedup->mask = entry_count / KISS_DEDUP_WAYS - 1;
+    // Round up so no more than KISS_DEDUP_BUCKETS cover the window, then count how many it takes
+    dedup->bucket_width = (window + KISS_DEDUP_BUCKETS - 1) / KISS_DEDUP_BUCKETS;
+    if (dedup->bucket_width == 0) dedup->bucket_width = 1;
+    dedup->buckets = (uint32_t) ((window + dedup->bucket_width - 1) / dedup->bucket_width);
+    if (dedup->buckets == 0) dedup->buckets = 1;
+    dedup->ignore_path = ignore_path;
+    kiss_dedup_clear(dedup);
+    return 0;
+}
+
+// Forget every frame
+void kiss_dedup_clear(kiss_dedup_t *dedup) {
+    memset(dedup->entries, 0, (dedup->mask + 1) * KISS_DEDUP_WAYS * sizeof(kiss_dedup_entry_t));
+}
+
+// Mix bytes into a hash a word at a time
+static uint64_t kiss_dedup_mix(uint64_t h, const uint8_t *data, size_t length) {
+    uint64_t w;
+
+    while (length >= 8) {
+        memcpy(&w, data, 8);
+        h = (h ^ w) * KISS_DEDUP_MULTIPLIER;
+        h ^= h >> 29;
+        data += 8;
+        length -= 8;
+    }
+    if (length > 0) {
+        w = 0;
+        memcpy(&w, data, length);
+        h = (h ^ w ^ ((uint64_t) length << 56)) * KISS_DEDUP_MULTIPLIER;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+// Mix in the number of bytes hashed, so data that differs only by trailing zeros hashes differently
+static uint64_t kiss_dedup_finish(uint64_t h, size_t length) {
+    h = (h ^ length) * KISS_DEDUP_MULTIPLIER;
+    return h ^ (h >> 32);
+}
+
+// Return the hash of a frame
+uint64_t kiss_dedup_hash(const kiss_dedup_t *dedup, const kiss_packet_t *p) {
+    uint64_t h = ((uint64_t) p->command << 8 | p->port) * KISS_DEDUP_MULTIPLIER;
+    uint8_t addresses[2 * KISS_AX25_ADDRESS_SIZE];
+    size_t end;
+
+    if (dedup->ignore_path && p->command == KISS_DATA_FRAME && p->data_length >= sizeof(addresses)) {
+        // Find the end of the address field, marked by the low bit of the last SSID byte
+        for (end = KISS_AX25_ADDRESS_SIZE - 1; end < p->data_length && end < KISS_AX25_MAX_HEADER; end += KISS_AX25_ADDRESS_SIZE) {
+            if (p->data[end] & 1) break;
+        }
+        if (end < p->data_length && end < KISS_AX25_MAX_HEADER) {
+            // Hash the destination and source, with only the SSID bits of their SSID bytes
+            memcpy(addresses, p->data, sizeof(addresses));
+            addresses[KISS_AX25_ADDRESS_SIZE - 1] &= 0x1E;
+            addresses[2 * KISS_AX25_ADDRESS_SIZE - 1] &= 0x1E;
+            h = kiss_dedup_mix(h, addresses, sizeof(addresses));
+            end++;
+            h = kiss_dedup_mix(h, p->data + end, p->data_length - end);
+            return kiss_dedup_finish(h, sizeof(addresses) + p->data_length - end);
+        }
+    }
+    h = kiss_dedup_mix(h, p->data, p->data_length);
+    return kiss_dedup_finish(h, p->data_length);
+}
+
+// Remember a frame seen at now
+int kiss_dedup_check(kiss_dedup_t *dedup, const kiss_packet_t *packet, uint64_t now) {
+    uint64_t h = kiss_dedup_hash(dedup, packet);
+    kiss_dedup_entry_t *set = dedup->entries + (h & dedup->mask) * KISS_DEDUP_WAYS;
+    uint32_t fingerprint = (uint32_t) (h >> 32);
+    uint32_t time = (uint32_t) (now / dedup->bucket_width) + 1;
+    uint32_t oldest_age = 0;
+    kiss_dedup_entry_t *victim = set;
+
+    for (int way = 0; way < KISS_DEDUP_WAYS; way++) {
+        kiss_dedup_entry_t *e = &set[way];
+        // Unsigned, so a free entry looks older than anything else
+        uint32_t age = e->time ? time - e->time : UINT32_MAX;
+        if (age < dedup->buckets && e->fingerprint == fingerprint) {
+            dedup->duplicates++;
+            return 1;
+        }
+        if (age >= oldest_age) {
+            oldest_age = age;
+            victim = e;
+        }
+    }
+    if (oldest_age < dedup->buckets) dedup->evicted++;
+    victim->fingerprint = fingerprint;
+    victim->time = time;
+    dedup->unique++;
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
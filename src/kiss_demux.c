@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_demux.h"
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Initialize a demultiplexer with no handlers
+void kiss_demux_init(kiss_demux_t *demux) {
+    memset(demux, 0, sizeof(*demux));
+}
+
+// Register a handler for a port and command, or remove it if handler is 0
+void kiss_demux_register(kiss_demux_t *demux, uint8_t port, kiss_command_t command, kiss_handler_t handler, void *context) {
+    port &= 0x0f;
+    uint8_t c = command & 0x0f;
+    demux->handlers[port][c] = handler;
+    demux->contexts[port][c] = context;
+    if (handler) {
+        demux->accept[port] |= (uint16_t) (1 << c);
+    } else {
+        demux->accept[port] &= (uint16_t) ~(1 << c);
+    }
+}
+
+// Route frames to a decoder's packet through this demultiplexer's accept masks
+void kiss_demux_attach(kiss_demux_t *demux, kiss_decoder_t *decoder) {
+    kiss_decoder_set_filter(decoder, demux->accept);
+}
+
+// Route a decoded packet to its handler, returns 1 if a handler was called
+uint8_t kiss_demux_dispatch(kiss_demux_t *demux, const kiss_packet_t *packet) {
+    uint8_t port = packet->port & 0x0f;
+    uint8_t c = packet->command & 0x0f;
+    kiss_handler_t handler = demux->handlers[port][c];
+    if (!handler) {
+        demux->stats[port].unhandled++;
+        return 0;
+    }
+    demux->stats[port].frames++;
+    demux->stats[port].bytes += packet->data_length;
+    handler(packet, demux->contexts[port][c]);
+    return 1;
+}
+
+// Feed bytes to a decoder and dispatch every complete packet, returns bytes consumed
+size_t kiss_demux_push(kiss_demux_t *demux, kiss_decoder_t *decoder, const uint8_t *buffer, size_t buffer_size) {
+    size_t offset = 0;
+    while (offset < buffer_size) {
+        offset += kiss_decoder_push(decoder, buffer + offset, buffer_size - offset);
+        if (decoder->packet.complete_packet) {
+            kiss_demux_dispatch(demux, &decoder->packet);
+        }
+    }
+    return offset;
+}
+
+// Dispatch every complete frame in a buffer, decoding wanted frames in place
+size_t kiss_demux_decode(kiss_demux_t *demux, uint8_t *buffer, size_t buffer_size, size_t *resume) {
+    kiss_frame_t frames[16];
+    size_t dispatched = 0;
+    size_t offset = 0;
+
+    for (;;) {
+        size_t next = 0;
+        size_t count = kiss_decode_packets(buffer + offset, buffer_size - offset, frames, 16, &next);
+        for (size_t i = 0; i < count && frames[i].complete_frame; i++) {
+            kiss_frame_t *f = &frames[i];
+            uint8_t port = f->port & 0x0f;
+            if (!(demux->accept[port] & (1 << (f->command & 0x0f)))) {
+                // Dropped without being unescaped
+                demux->stats[port].unhandled++;
+                continue;
+            }
+            kiss_packet_t p = {
+                .command = f->command,
+                .port = f->port,
+                .complete_packet = 1,
+                .data = kiss_frame_data(buffer + offset, f),
+                .data_length = f->data_length,
+                .data_capacity = f->encoded_length
+            };
+            dispatched += kiss_demux_dispatch(demux, &p);
+        }
+        offset += next;
+        // A short batch means the whole buffer was scanned
+        if (count < 16 || !frames[15].complete_frame) break;
+    }
+
+    if (resume) *resume = offset;
+    return dispatched;
+}
+
+// A handler that queues packets in the kiss_ring_t given as its context
+void kiss_demux_queue_handler(const kiss_packet_t *packet, void *context) {
+    kiss_ring_put_packet((kiss_ring_t *) context, packet);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,232 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_loop.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Initialize a loop whose packets hold up to packet_size bytes of data
+int kiss_loop_init(kiss_loop_t *loop, size_t packet_size) {
+    memset(loop, 0, sizeof(*loop));
+    loop->packet_size = packet_size;
+    loop->read_buffer = malloc(KISS_LOOP_READ_SIZE);
+    if (!loop->read_buffer) return -1;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        free(loop->read_buffer);
+        loop->read_buffer = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Queue a stream for another turn at reading
+static void kiss_loop_make_ready(kiss_loop_t *loop, kiss_loop_stream_t *s) {
+    if (s->ready) return;
+    s->ready = 1;
+    s->next_ready = 0;
+    if (loop->ready_tail) {
+        loop->ready_tail->next_ready = s;
+    } else {
+        loop->ready_head = s;
+    }
+    loop->ready_tail = s;
+}
+
+// Add a file descriptor and make it nonblocking, returns the new stream or 0 on failure
+kiss_loop_stream_t* kiss_loop_add(kiss_loop_t *loop, int fd, kiss_handler_t handler, kiss_loop_closed_t closed, void *context) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return 0;
+
+    // The packet buffer lives right after the stream
+    kiss_loop_stream_t *s = malloc(sizeof(kiss_loop_stream_t) + loop->packet_size);
+    if (!s) return 0;
+    memset(s, 0, sizeof(*s));
+    s->loop = loop;
+    s->fd = fd;
+    s->decoder = kiss_new_decoder((uint8_t *) (s + 1), loop->packet_size);
+    s->handler = handler;
+    s->closed = closed;
+    s->context = context;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = s;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        if (errno != EPERM) {
+            free(s);
+            return 0;
+        }
+        // A regular file, epoll refuses it because it is always readable, so read it every turn until end of file
+        s->hangup = 1;
+    }
+
+    s->next = loop->streams;
+    loop->streams = s;
+    loop->stream_count++;
+    // Anything that arrived before the stream was added will not raise an edge
+    kiss_loop_make_ready(loop, s);
+    return s;
+}
+
+// Mark a stream as removed, it is freed at the end of the turn
+static void kiss_loop_remove_stream(kiss_loop_t *loop, kiss_loop_stream_t *s) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, s->fd, 0);
+    s->removed = 1;
+    loop->stream_count--;
+    loop->removed_count++;
+}
+
+// Stop watching a file descriptor, it is not closed
+int kiss_loop_remove(kiss_loop_t *loop, int fd) {
+    for (kiss_loop_stream_t *s = loop->streams; s; s = s->next) {
+        if (s->fd == fd && !s->removed) {
+            kiss_loop_remove_stream(loop, s);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Free streams removed during the last turn
+static void kiss_loop_reap(kiss_loop_t *loop) {
+    kiss_loop_stream_t **link = &loop->streams;
+    while (*link) {
+        kiss_loop_stream_t *s = *link;
+        if (s->removed && !s->ready) {
+            *link = s->next;
+            free(s);
+            loop->removed_count--;
+        } else {
+            link = &s->next;
+        }
+    }
+}
+
+// Read and decode up to the read budget, returns packets handled. Leaves the stream ready if data may remain.
+static int kiss_loop_read_stream(kiss_loop_t *loop, kiss_loop_stream_t *s) {
+    int packets = 0;
+    for (int reads = 0; reads < KISS_LOOP_READ_BUDGET && !s->removed; reads++) {
+        ssize_t n = read(s->fd, loop->read_buffer, KISS_LOOP_READ_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return packets;
+        if (n <= 0) {
+            // End of file or a real error, this stream is finished
+            int error = (n < 0) ? errno : 0;
+            kiss_loop_remove_stream(loop, s);
+            if (s->closed) s->closed(s->fd, error, s->context);
+            return packets;
+        }
+
+        size_t offset = 0;
+        while (offset < (size_t) n && !s->removed) {
+            offset += kiss_decoder_push(&s->decoder, loop->read_buffer + offset, (size_t) n - offset);
+            if (s->decoder.packet.complete_packet) {
+                s->handler(&s->decoder.packet, s->context);
+                packets++;
+            }
+        }
+        // A short read means the stream is drained, unless end of file is still to come
+        if ((size_t) n < KISS_LOOP_READ_SIZE && !s->hangup) return packets;
+    }
+    if (!s->removed) kiss_loop_make_ready(loop, s);
+    return packets;
+}
+
+// Wait up to timeout_ms for data and decode it, returns the number of packets handled or -1 on error
+int kiss_loop_run_once(kiss_loop_t *loop, int timeout_ms) {
+    // Streams still holding data must not wait for a new edge
+    int count = epoll_wait(loop->epoll_fd, loop->events, KISS_LOOP_MAX_EVENTS, loop->ready_head ? 0 : timeout_ms);
+    if (count < 0) return (errno == EINTR) ? 0 : -1;
+    for (int i = 0; i < count; i++) {
+        kiss_loop_stream_t *s = loop->events[i].data.ptr;
+        if (loop->events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) s->hangup = 1;
+        if (!s->removed) kiss_loop_make_ready(loop, s);
+    }
+
+    // Only visit the streams that were ready when this turn started
+    kiss_loop_stream_t *s = loop->ready_head;
+    kiss_loop_stream_t *last = loop->ready_tail;
+    loop->ready_head = 0;
+    loop->ready_tail = 0;
+    int packets = 0;
+    while (s) {
+        kiss_loop_stream_t *next = (s == last) ? 0 : s->next_ready;
+        s->ready = 0;
+        if (!s->removed) packets += kiss_loop_read_stream(loop, s);
+        s = next;
+    }
+
+    if (loop->removed_count) kiss_loop_reap(loop);
+    return packets;
+}
+
+// Run until kiss_loop_stop is called or no streams are left
+int kiss_loop_run(kiss_loop_t *loop) {
+    loop->running = 1;
+    while (loop->running && loop->stream_count > 0) {
+        if (kiss_loop_run_once(loop, -1) < 0) return -1;
+    }
+    return 0;
+}
+
+// Make kiss_loop_run return after the current turn
+void kiss_loop_stop(kiss_loop_t *loop) {
+    loop->running = 0;
+}
+
+// Release all streams and memory, file descriptors are not closed
+void kiss_loop_free(kiss_loop_t *loop) {
+    kiss_loop_stream_t *s = loop->streams;
+    while (s) {
+        kiss_loop_stream_t *next = s->next;
+        free(s);
+        s = next;
+    }
+    loop->streams = 0;
+    loop->ready_head = 0;
+    loop->ready_tail = 0;
+    loop->stream_count = 0;
+    loop->removed_count = 0;
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+    loop->epoll_fd = -1;
+    free(loop->read_buffer);
+    loop->read_buffer = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
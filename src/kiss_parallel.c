@@ -0,0 +1,270 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_parallel.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define KISS_PARALLEL_DEFAULT_CHUNK (4 * 1024 * 1024)
+#define KISS_PARALLEL_BATCH 64
+
+struct kiss_parallel_job {
+    const uint8_t *buffer;
+    size_t buffer_size;
+    size_t chunk_size;
+    size_t chunk_count;
+    uint8_t ordered;
+    kiss_handler_t handler;
+    void *context;
+    size_t next_chunk;          // Next chunk to claim
+    size_t delivered_chunks;    // Chunks delivered so far when ordered
+    long long frames;
+    int failed;
+    pthread_mutex_t lock;
+    pthread_cond_t turn;
+};
+
+// A frame kept until its chunk's turn, data is either in the buffer or in the arena
+struct kiss_parallel_frame {
+    kiss_frame_t frame;
+    size_t arena_offset;
+};
+
+struct kiss_parallel_worker {
+    struct kiss_parallel_job *job;
+    struct kiss_parallel_frame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    uint8_t *arena;
+    size_t arena_length;
+    size_t arena_capacity;
+};
+
+// Return the position of the first FEND at or after offset
+static size_t kiss_parallel_align(const uint8_t *buffer, size_t buffer_size, size_t offset) {
+    if (offset >= buffer_size) return buffer_size;
+    const uint8_t *p = memchr(buffer + offset, KISS_FRAME_END, buffer_size - offset);
+    return p ? (size_t) (p - buffer) : buffer_size;
+}
+
+static int kiss_parallel_grow(void **data, size_t *capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) return 0;
+    size_t size = *capacity ? *capacity : 64;
+    while (size < needed) size *= 2;
+    void *p = realloc(*data, size * element_size);
+    if (!p) return -1;
+    *data = p;
+    *capacity = size;
+    return 0;
+}
+
+// Build a packet for a frame, data is either decoded already or a view into the buffer
+static kiss_packet_t kiss_parallel_packet(const uint8_t *chunk, const kiss_frame_t *f, uint8_t *data) {
+    kiss_packet_t p = {
+        .command = f->command,
+        .port = f->port,
+        .complete_packet = 1,
+        .data = data ? data : (uint8_t *) chunk + f->offset,
+        .data_length = f->data_length,
+        .data_capacity = f->data_length
+    };
+    return p;
+}
+
+// Decode a chunk, delivering frames straight away or keeping them for later
+static int kiss_parallel_chunk(struct kiss_parallel_worker *w, size_t chunk) {
+    struct kiss_parallel_job *job = w->job;
+    size_t start = kiss_parallel_align(job->buffer, job->buffer_size, chunk * job->chunk_size);
+    size_t end = kiss_parallel_align(job->buffer, job->buffer_size, (chunk + 1) * job->chunk_size);
+    // Include the FEND that closes the last frame
+    if (end < job->buffer_size) end++;
+    if (chunk == 0) start = 0;
+
+    kiss_frame_t frames[KISS_PARALLEL_BATCH];
+    long long delivered = 0;
+    w->frame_count = 0;
+    w->arena_length = 0;
+
+    while (start < end) {
+        size_t resume = 0;
+        size_t count = kiss_decode_packets(job->buffer + start, end - start, frames, KISS_PARALLEL_BATCH, &resume);
+        const uint8_t *base = job->buffer + start;
+        for (size_t i = 0; i < count && frames[i].complete_frame; i++) {
+            kiss_frame_t *f = &frames[i];
+            uint8_t escaped = f->data_length != f->encoded_length;
+            if (escaped && kiss_parallel_grow((void **) &w->arena, &w->arena_capacity, w->arena_length + f->data_length, 1)) return -1;
+            uint8_t *data = escaped ? w->arena + w->arena_length : 0;
+            if (escaped) kiss_decode_data((uint8_t *) base + f->offset, f->encoded_length, data, f->data_length);
+
+            if (!job->ordered) {
+                kiss_packet_t p = kiss_parallel_packet(base, f, data);
+                job->handler(&p, job->context);
+                delivered++;
+                continue;
+            }
+
+            if (kiss_parallel_grow((void **) &w->frames, &w->frame_capacity, w->frame_count + 1, sizeof(*w->frames))) return -1;
+            struct kiss_parallel_frame *kept = &w->frames[w->frame_count++];
+            kept->frame = *f;
+            // Keep offsets relative to the whole buffer, the arena may move
+            kept->frame.offset += start;
+            kept->arena_offset = escaped ? w->arena_length : (size_t) -1;
+            if (escaped) w->arena_length += f->data_length;
+        }
+        if (count < KISS_PARALLEL_BATCH || resume == 0) break;
+        start += resume;
+    }
+
+    if (!job->ordered) {
+        __atomic_fetch_add(&job->frames, delivered, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    // Wait for every earlier chunk, then deliver this one
+    pthread_mutex_lock(&job->lock);
+    while (job->delivered_chunks != chunk && !job->failed) pthread_cond_wait(&job->turn, &job->lock);
+    int failed = job->failed;
+    pthread_mutex_unlock(&job->lock);
+    if (failed) return -1;
+
+    for (size_t i = 0; i < w->frame_count; i++) {
+        struct kiss_parallel_frame *kept = &w->frames[i];
+        uint8_t *data = (kept->arena_offset != (size_t) -1) ? w->arena + kept->arena_offset : 0;
+        kiss_packet_t p = kiss_parallel_packet(job->buffer, &kept->frame, data);
+        job->handler(&p, job->context);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->frames += w->frame_count;
+    job->delivered_chunks++;
+    pthread_cond_broadcast(&job->turn);
+    pthread_mutex_unlock(&job->lock);
+    return 0;
+}
+
+static void* kiss_parallel_thread(void *arg) {
+    struct kiss_parallel_worker *w = (struct kiss_parallel_worker *) arg;
+    struct kiss_parallel_job *job = w->job;
+    for (;;) {
+        size_t chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+        if (chunk >= job->chunk_count) break;
+        if (kiss_parallel_chunk(w, chunk) != 0) {
+            // Wake anyone waiting for this chunk's turn
+            pthread_mutex_lock(&job->lock);
+            job->failed = 1;
+            pthread_cond_broadcast(&job->turn);
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+    }
+    return 0;
+}
+
+// Decode a large buffer of encoded frames on a pool of threads
+long long kiss_decode_parallel(const uint8_t *buffer, size_t buffer_size, const kiss_parallel_options_t *options, kiss_handler_t handler, void *context) {
+    size_t threads = options ? options->threads : 0;
+    size_t chunk_size = (options && options->chunk_size) ? options->chunk_size : KISS_PARALLEL_DEFAULT_CHUNK;
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t) cpus : 1;
+    }
+
+    struct kiss_parallel_job job = {
+        .buffer = buffer,
+        .buffer_size = buffer_size,
+        .chunk_size = chunk_size,
+        .chunk_count = (buffer_size + chunk_size - 1) / chunk_size,
+        .ordered = options ? options->ordered : 0,
+        .handler = handler,
+        .context = context
+    };
+    if (threads > job.chunk_count) threads = job.chunk_count ? job.chunk_count : 1;
+    pthread_mutex_init(&job.lock, 0);
+    pthread_cond_init(&job.turn, 0);
+
+    struct kiss_parallel_worker *workers = calloc(threads, sizeof(*workers));
+    pthread_t *ids = calloc(threads, sizeof(*ids));
+    size_t started = 0;
+    if (workers && ids) {
+        for (; started < threads; started++) {
+            workers[started].job = &job;
+            if (pthread_create(&ids[started], 0, kiss_parallel_thread, &workers[started]) != 0) break;
+        }
+    }
+    if (started == 0) job.failed = 1;
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(ids[i], 0);
+        free(workers[i].frames);
+        free(workers[i].arena);
+    }
+    free(workers);
+    free(ids);
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.turn);
+
+    return job.failed ? -1 : job.frames;
+}
+
+// Map a capture file into memory and decode it with kiss_decode_parallel
+long long kiss_decode_file(const char *path, const kiss_parallel_options_t *options, kiss_handler_t handler, void *context) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *data = mmap(0, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+#if defined(MADV_SEQUENTIAL)
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    long long frames = kiss_decode_parallel((const uint8_t *) data, (size_t) st.st_size, options, handler, context);
+    munmap(data, (size_t) st.st_size);
+    return frames;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __unix__ || __APPLE__
@@ -0,0 +1,331 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_pipeline.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include "kiss_atomic.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// How long the reader waits in poll() before checking whether to stop
+#define KISS_PIPELINE_POLL_MS 50
+
+static size_t kiss_round_up_power_of_two(size_t n) {
+    size_t size = 2;
+    while (size < n) size <<= 1;
+    return size;
+}
+
+// Back off while waiting for another thread: spin, then yield, then sleep
+static void kiss_backoff(unsigned int *attempt) {
+    if (*attempt >= 128) {
+        struct timespec t = {0, 200000};
+        nanosleep(&t, 0);
+    } else if (*attempt >= 64) {
+        sched_yield();
+    }
+    (*attempt)++;
+}
+
+// Initialize a pipeline whose packets hold up to packet_size bytes of data
+void kiss_pipeline_init(kiss_pipeline_t *pipeline, size_t packet_size) {
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->packet_size = packet_size;
+}
+
+// Add a file descriptor to read from
+int kiss_pipeline_add_stream(kiss_pipeline_t *pipeline, int fd, size_t ring_size) {
+    if (pipeline->stream_count >= KISS_PIPELINE_MAX_STREAMS) return -1;
+    kiss_pipeline_stream_t *s = &pipeline->streams[pipeline->stream_count];
+    memset(s, 0, sizeof(*s));
+    ring_size = kiss_round_up_power_of_two(ring_size);
+
+    uint8_t *ring_buffer = malloc(ring_size);
+    if (!ring_buffer) return -1;
+    s->pipeline = pipeline;
+    s->fd = fd;
+    s->ring = kiss_new_ring(ring_buffer, ring_size);
+    // The decoder gets a pooled buffer when the pipeline starts
+    s->decoder = kiss_new_decoder(0, pipeline->packet_size);
+    pipeline->stream_count++;
+    return 0;
+}
+
+// Add a consumer
+int kiss_pipeline_add_consumer(kiss_pipeline_t *pipeline, kiss_handler_t handler, void *context, kiss_queue_policy_t policy, size_t queue_size) {
+    if (pipeline->consumer_count >= KISS_PIPELINE_MAX_CONSUMERS) return -1;
+    kiss_pipeline_consumer_t *c = &pipeline->consumers[pipeline->consumer_count];
+    memset(c, 0, sizeof(*c));
+    queue_size = kiss_round_up_power_of_two(queue_size);
+
+    // Slots only carry shared packets, so they need no data of their own
+    c->cells = malloc(queue_size * sizeof(kiss_mpmc_cell_t));
+    if (!c->cells) return -1;
+    kiss_mpmc_init(&c->queue, c->cells, queue_size, 0, 0);
+    c->pipeline = pipeline;
+    c->handler = handler;
+    c->context = context;
+    c->policy = policy;
+    pipeline->consumer_count++;
+    return 0;
+}
+
+// Moves bytes from the file descriptor into the ring, nothing else
+static void* kiss_pipeline_reader(void *arg) {
+    kiss_pipeline_stream_t *s = (kiss_pipeline_stream_t *) arg;
+    kiss_pipeline_t *pipeline = s->pipeline;
+    unsigned int attempt = 0;
+    struct pollfd pfd = {.fd = s->fd, .events = POLLIN};
+
+    while (KISS_LOAD_ACQUIRE(&pipeline->running)) {
+        size_t available;
+        uint8_t *p = kiss_ring_write_ptr(&s->ring, &available);
+        if (available == 0) {
+            // The decoder is behind, wait for it
+            if (KISS_LOAD_ACQUIRE(&s->done)) break;
+            kiss_backoff(&attempt);
+            continue;
+        }
+        attempt = 0;
+
+        int ready = poll(&pfd, 1, KISS_PIPELINE_POLL_MS);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        ssize_t bytes_read = read(s->fd, p, available);
+        if (bytes_read < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (bytes_read <= 0) break;
+        kiss_ring_commit(&s->ring, (size_t) bytes_read);
+    }
+
+    KISS_STORE_RELEASE(&s->read_eof, 1);
+    return 0;
+}
+
+// Put a reference to a pooled packet on a consumer's queue following its policy
+static void kiss_pipeline_deliver(kiss_pipeline_consumer_t *c, kiss_packet_t *packet) {
+    unsigned int attempt = 0;
+    for (;;) {
+        kiss_mpmc_cell_t *cell = kiss_mpmc_begin_push(&c->queue);
+        if (cell) {
+            kiss_pool_retain(packet);
+            cell->shared = packet;
+            kiss_mpmc_end_push(&c->queue, cell);
+            return;
+        }
+        if (c->policy == KISS_QUEUE_DROP_NEWEST || !KISS_LOAD_ACQUIRE(&c->pipeline->running)) {
+            KISS_FETCH_ADD(&c->dropped, 1);
+            return;
+        }
+        if (c->policy == KISS_QUEUE_DROP_OLDEST) {
+            cell = kiss_mpmc_begin_pop(&c->queue);
+            if (cell) {
+                kiss_pool_release(cell->shared);
+                kiss_mpmc_end_pop(&c->queue, cell);
+                KISS_FETCH_ADD(&c->dropped, 1);
+            }
+            continue;
+        }
+        kiss_backoff(&attempt);
+    }
+}
+
+// Give the decoder a fresh pooled buffer, waiting for one if necessary. Returns 0 on success or -1 once stopped.
+static int kiss_pipeline_next_buffer(kiss_pipeline_t *pipeline, kiss_pipeline_stream_t *s) {
+    unsigned int attempt = 0;
+    while (!(s->packet = kiss_pool_alloc(&pipeline->pool, pipeline->packet_size))) {
+        if (!KISS_LOAD_ACQUIRE(&pipeline->running)) return -1;
+        kiss_backoff(&attempt);
+    }
+    s->decoder.packet.data = s->packet->data;
+    s->decoder.packet.data_capacity = pipeline->packet_size;
+    return 0;
+}
+
+// Decodes bytes from the ring and hands each packet to every consumer
+static void* kiss_pipeline_decoder(void *arg) {
+    kiss_pipeline_stream_t *s = (kiss_pipeline_stream_t *) arg;
+    kiss_pipeline_t *pipeline = s->pipeline;
+    unsigned int attempt = 0;
+
+    while (KISS_LOAD_ACQUIRE(&pipeline->running)) {
+        if (kiss_ring_length(&s->ring) == 0) {
+            // Check end of file before the ring again, so no bytes are missed
+            if (KISS_LOAD_ACQUIRE(&s->read_eof) && kiss_ring_length(&s->ring) == 0) break;
+            kiss_backoff(&attempt);
+            continue;
+        }
+        attempt = 0;
+        kiss_ring_decode(&s->ring, &s->decoder);
+        if (s->decoder.packet.complete_packet) {
+            // The packet was decoded straight into the pooled buffer, only the header is copied
+            kiss_packet_t *packet = s->packet;
+            *packet = s->decoder.packet;
+            for (size_t i = 0; i < pipeline->consumer_count; i++) {
+                kiss_pipeline_deliver(&pipeline->consumers[i], packet);
+            }
+            kiss_pool_release(packet);
+            if (kiss_pipeline_next_buffer(pipeline, s) < 0) break;
+        }
+    }
+    if (s->packet) {
+        kiss_pool_release(s->packet);
+        s->packet = 0;
+    }
+
+    KISS_STORE_RELEASE(&s->done, 1);
+    // Everything this decoder queued must be visible to a consumer that sees the count
+    KISS_FENCE_RELEASE();
+    KISS_FETCH_ADD(&pipeline->streams_done, 1);
+    return 0;
+}
+
+// Runs a handler for each packet in a consumer's queue
+static void* kiss_pipeline_consumer(void *arg) {
+    kiss_pipeline_consumer_t *c = (kiss_pipeline_consumer_t *) arg;
+    kiss_pipeline_t *pipeline = c->pipeline;
+    unsigned int attempt = 0;
+
+    while (KISS_LOAD_ACQUIRE(&pipeline->running)) {
+        // Nothing more can arrive once every decoder is done, check that before popping
+        uint8_t finished = KISS_LOAD_ACQUIRE(&pipeline->streams_done) == pipeline->stream_count;
+        kiss_mpmc_cell_t *cell = kiss_mpmc_begin_pop(&c->queue);
+        if (cell) {
+            attempt = 0;
+            // Free the slot first, the packet stays valid until its reference is dropped
+            kiss_packet_t *packet = cell->shared;
+            kiss_mpmc_end_pop(&c->queue, cell);
+            c->handler(packet, c->context);
+            kiss_pool_release(packet);
+            KISS_FETCH_ADD(&c->delivered, 1);
+        } else if (finished) {
+            break;
+        } else {
+            kiss_backoff(&attempt);
+        }
+    }
+    return 0;
+}
+
+// Create the pool shared by every stream and consumer, returns 0 on success
+static int kiss_pipeline_init_pool(kiss_pipeline_t *pipeline) {
+    // Every queue full, and a packet in the hands of each consumer and decoder
+    size_t count = pipeline->stream_count + pipeline->consumer_count;
+    for (size_t i = 0; i < pipeline->consumer_count; i++) {
+        count += pipeline->consumers[i].queue.mask + 1;
+    }
+    size_t arena_size = kiss_pool_arena_size(&pipeline->packet_size, &count, 1);
+    pipeline->arena = malloc(arena_size);
+    if (!pipeline->arena) return -1;
+    if (kiss_pool_init(&pipeline->pool, pipeline->arena, arena_size, &pipeline->packet_size, &count, 1) != 0) {
+        free(pipeline->arena);
+        pipeline->arena = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Start all threads, returns 0 on success
+int kiss_pipeline_start(kiss_pipeline_t *pipeline) {
+    if (!pipeline->arena && kiss_pipeline_init_pool(pipeline) != 0) return -1;
+    KISS_STORE_RELEASE(&pipeline->running, 1);
+    for (size_t i = 0; i < pipeline->consumer_count; i++) {
+        kiss_pipeline_consumer_t *c = &pipeline->consumers[i];
+        if (pthread_create(&c->thread, 0, kiss_pipeline_consumer, c) != 0) goto error;
+        c->started = 1;
+    }
+    for (size_t i = 0; i < pipeline->stream_count; i++) {
+        kiss_pipeline_stream_t *s = &pipeline->streams[i];
+        if (!s->packet && kiss_pipeline_next_buffer(pipeline, s) < 0) goto error;
+        if (pthread_create(&s->decoder_thread, 0, kiss_pipeline_decoder, s) != 0) goto error;
+        s->decoder_started = 1;
+        if (pthread_create(&s->reader_thread, 0, kiss_pipeline_reader, s) != 0) goto error;
+        s->reader_started = 1;
+    }
+    return 0;
+
+error:
+    kiss_pipeline_stop(pipeline);
+    return -1;
+}
+
+static void kiss_pipeline_join(kiss_pipeline_t *pipeline) {
+    for (size_t i = 0; i < pipeline->stream_count; i++) {
+        kiss_pipeline_stream_t *s = &pipeline->streams[i];
+        if (s->reader_started) pthread_join(s->reader_thread, 0);
+        if (s->decoder_started) pthread_join(s->decoder_thread, 0);
+        s->reader_started = 0;
+        s->decoder_started = 0;
+    }
+    for (size_t i = 0; i < pipeline->consumer_count; i++) {
+        kiss_pipeline_consumer_t *c = &pipeline->consumers[i];
+        if (c->started) pthread_join(c->thread, 0);
+        c->started = 0;
+    }
+}
+
+// Wait until every stream reaches end of file and every queued packet is handled
+void kiss_pipeline_wait(kiss_pipeline_t *pipeline) {
+    kiss_pipeline_join(pipeline);
+    KISS_STORE_RELEASE(&pipeline->running, 0);
+}
+
+// Stop all threads, dropping anything not yet handled
+void kiss_pipeline_stop(kiss_pipeline_t *pipeline) {
+    KISS_STORE_RELEASE(&pipeline->running, 0);
+    kiss_pipeline_join(pipeline);
+}
+
+// Release all memory used by a stopped pipeline
+void kiss_pipeline_free(kiss_pipeline_t *pipeline) {
+    for (size_t i = 0; i < pipeline->stream_count; i++) {
+        kiss_pipeline_stream_t *s = &pipeline->streams[i];
+        free(s->ring.buffer);
+    }
+    for (size_t i = 0; i < pipeline->consumer_count; i++) {
+        free(pipeline->consumers[i].cells);
+    }
+    // Packets still queued in a stopped pipeline go with the arena
+    free(pipeline->arena);
+    pipeline->arena = 0;
+    pipeline->stream_count = 0;
+    pipeline->consumer_count = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __unix__ || __APPLE__
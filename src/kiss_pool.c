@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_pool.h"
+#include "kiss_atomic.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Buffer headers and data are kept aligned to this many bytes
+#define KISS_POOL_ALIGN 16
+
+static size_t kiss_pool_align(size_t n) {
+    return (n + KISS_POOL_ALIGN - 1) & ~((size_t) KISS_POOL_ALIGN - 1);
+}
+
+// Return the arena size needed for the given classes
+size_t kiss_pool_arena_size(const size_t *data_sizes, const size_t *counts, size_t class_count) {
+    // Leave room to align the start of the arena
+    size_t size = KISS_POOL_ALIGN;
+    for (size_t i = 0; i < class_count; i++) {
+        size += counts[i] * (kiss_pool_align(sizeof(kiss_pool_buffer_t)) + kiss_pool_align(data_sizes[i]));
+    }
+    return size;
+}
+
+// Initialize a pool in an arena
+int kiss_pool_init(kiss_pool_t *pool, uint8_t *arena, size_t arena_size, const size_t *data_sizes, const size_t *counts, size_t class_count) {
+    if (class_count > KISS_POOL_MAX_CLASSES) return -1;
+    if (arena_size < kiss_pool_arena_size(data_sizes, counts, class_count)) return -1;
+
+    uint8_t *p = arena + (kiss_pool_align((uintptr_t) arena) - (uintptr_t) arena);
+    pool->class_count = class_count;
+    for (size_t c = 0; c < class_count; c++) {
+        kiss_pool_class_t *pc = &pool->classes[c];
+        if (c > 0 && data_sizes[c] < data_sizes[c - 1]) return -1;
+        pc->data_size = data_sizes[c];
+        pc->count = counts[c];
+        pc->available = counts[c];
+        pc->free_list = 0;
+        pc->lock = 0;
+        for (size_t i = 0; i < counts[c]; i++) {
+            kiss_pool_buffer_t *b = (kiss_pool_buffer_t *) p;
+            p += kiss_pool_align(sizeof(kiss_pool_buffer_t));
+            b->packet = kiss_new_packet(p, data_sizes[c]);
+            p += kiss_pool_align(data_sizes[c]);
+            b->pool = pool;
+            b->references = 0;
+            b->size_class = (uint8_t) c;
+            b->next = pc->free_list;
+            pc->free_list = b;
+        }
+    }
+    return 0;
+}
+
+// Take a buffer from the smallest class that holds data_size bytes
+kiss_packet_t* kiss_pool_alloc(kiss_pool_t *pool, size_t data_size) {
+    for (size_t c = 0; c < pool->class_count; c++) {
+        kiss_pool_class_t *pc = &pool->classes[c];
+        if (pc->data_size < data_size) continue;
+
+        KISS_LOCK(&pc->lock);
+        kiss_pool_buffer_t *b = pc->free_list;
+        if (b) {
+            pc->free_list = b->next;
+            pc->available--;
+        }
+        KISS_UNLOCK(&pc->lock);
+
+        if (b) {
+            b->next = 0;
+            b->references = 1;
+            kiss_clear_packet(&b->packet);
+            return &b->packet;
+        }
+        // This class is empty, try a bigger one
+    }
+    return 0;
+}
+
+// Add a reference to a pooled packet
+void kiss_pool_retain(kiss_packet_t *packet) {
+    kiss_pool_buffer_t *b = (kiss_pool_buffer_t *) packet;
+    KISS_FETCH_ADD(&b->references, 1);
+}
+
+// Drop a reference to a pooled packet
+void kiss_pool_release(kiss_packet_t *packet) {
+    kiss_pool_buffer_t *b = (kiss_pool_buffer_t *) packet;
+    if (KISS_FETCH_SUB(&b->references, 1) != 1) return;
+
+    kiss_pool_class_t *pc = &b->pool->classes[b->size_class];
+    KISS_LOCK(&pc->lock);
+    b->next = pc->free_list;
+    pc->free_list = b;
+    pc->available++;
+    KISS_UNLOCK(&pc->lock);
+}
+
+// Return the number of free buffers in a class
+size_t kiss_pool_available(kiss_pool_t *pool, size_t size_class) {
+    if (size_class >= pool->class_count) return 0;
+    return KISS_LOAD_RELAXED(&pool->classes[size_class].available);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,172 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_queue.h"
+#include "kiss_atomic.h"
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static int kiss_is_power_of_two(size_t n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// Initialize a single producer, single consumer queue
+int kiss_spsc_init(kiss_spsc_t *queue, kiss_packet_t *slots, size_t slot_count, uint8_t *data, size_t slot_data_size) {
+    if (!kiss_is_power_of_two(slot_count)) return -1;
+    memset(queue, 0, sizeof(*queue));
+    queue->slots = slots;
+    queue->mask = slot_count - 1;
+    for (size_t i = 0; i < slot_count; i++) {
+        slots[i] = kiss_new_packet(data + i * slot_data_size, slot_data_size);
+    }
+    return 0;
+}
+
+// Return an empty slot to fill, or 0 if the queue is full
+kiss_packet_t* kiss_spsc_begin_push(kiss_spsc_t *queue) {
+    size_t head = queue->head;
+    if (head - queue->cached_tail > queue->mask) {
+        // Only look at the consumer's index when the cached one says we are full
+        queue->cached_tail = KISS_LOAD_ACQUIRE(&queue->tail);
+        if (head - queue->cached_tail > queue->mask) return 0;
+    }
+    kiss_packet_t *p = &queue->slots[head & queue->mask];
+    kiss_clear_packet(p);
+    return p;
+}
+
+// Publish the slot returned by kiss_spsc_begin_push
+void kiss_spsc_end_push(kiss_spsc_t *queue) {
+    KISS_STORE_RELEASE(&queue->head, queue->head + 1);
+}
+
+// Return the oldest packet, or 0 if the queue is empty
+kiss_packet_t* kiss_spsc_begin_pop(kiss_spsc_t *queue) {
+    size_t tail = queue->tail;
+    if (tail == queue->cached_head) {
+        queue->cached_head = KISS_LOAD_ACQUIRE(&queue->head);
+        if (tail == queue->cached_head) return 0;
+    }
+    return &queue->slots[tail & queue->mask];
+}
+
+// Release the slot returned by kiss_spsc_begin_pop
+void kiss_spsc_end_pop(kiss_spsc_t *queue) {
+    KISS_STORE_RELEASE(&queue->tail, queue->tail + 1);
+}
+
+#ifdef KISS_COMPARE_EXCHANGE
+
+/**
+ * The multiple producer, multiple consumer queue follows Dmitry Vyukov's
+ * bounded queue. Each cell's sequence number says whose turn it is: a cell
+ * at position pos is free for the producer when sequence == pos, and holds
+ * a packet for the consumer when sequence == pos + 1.
+ */
+
+// Initialize a multiple producer, multiple consumer queue
+int kiss_mpmc_init(kiss_mpmc_t *queue, kiss_mpmc_cell_t *cells, size_t slot_count, uint8_t *data, size_t slot_data_size) {
+    if (!kiss_is_power_of_two(slot_count)) return -1;
+    memset(queue, 0, sizeof(*queue));
+    queue->cells = cells;
+    queue->mask = slot_count - 1;
+    for (size_t i = 0; i < slot_count; i++) {
+        cells[i].sequence = i;
+        cells[i].packet = kiss_new_packet(data ? data + i * slot_data_size : 0, slot_data_size);
+        cells[i].shared = 0;
+    }
+    return 0;
+}
+
+// Claim an empty slot to fill, or 0 if the queue is full
+kiss_mpmc_cell_t* kiss_mpmc_begin_push(kiss_mpmc_t *queue) {
+    size_t pos = KISS_LOAD_RELAXED(&queue->enqueue_position);
+    for (;;) {
+        kiss_mpmc_cell_t *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = KISS_LOAD_ACQUIRE(&cell->sequence);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) pos;
+        if (difference == 0) {
+            if (KISS_COMPARE_EXCHANGE(&queue->enqueue_position, &pos, pos + 1)) {
+                kiss_clear_packet(&cell->packet);
+                return cell;
+            }
+        } else if (difference < 0) {
+            return 0;
+        } else {
+            pos = KISS_LOAD_RELAXED(&queue->enqueue_position);
+        }
+    }
+}
+
+// Publish a slot returned by kiss_mpmc_begin_push
+void kiss_mpmc_end_push(kiss_mpmc_t *queue, kiss_mpmc_cell_t *cell) {
+    (void) queue;
+    // Until now sequence still holds the position the cell was claimed at
+    KISS_STORE_RELEASE(&cell->sequence, cell->sequence + 1);
+}
+
+// Claim the oldest packet, or 0 if the queue is empty
+kiss_mpmc_cell_t* kiss_mpmc_begin_pop(kiss_mpmc_t *queue) {
+    size_t pos = KISS_LOAD_RELAXED(&queue->dequeue_position);
+    for (;;) {
+        kiss_mpmc_cell_t *cell = &queue->cells[pos & queue->mask];
+        size_t sequence = KISS_LOAD_ACQUIRE(&cell->sequence);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) (pos + 1);
+        if (difference == 0) {
+            if (KISS_COMPARE_EXCHANGE(&queue->dequeue_position, &pos, pos + 1)) {
+                return cell;
+            }
+        } else if (difference < 0) {
+            return 0;
+        } else {
+            pos = KISS_LOAD_RELAXED(&queue->dequeue_position);
+        }
+    }
+}
+
+// Release a slot returned by kiss_mpmc_begin_pop
+void kiss_mpmc_end_pop(kiss_mpmc_t *queue, kiss_mpmc_cell_t *cell) {
+    // sequence is pos + 1, the next producer will use pos + capacity
+    KISS_STORE_RELEASE(&cell->sequence, cell->sequence + queue->mask);
+}
+
+#endif // KISS_COMPARE_EXCHANGE
+
+// Copy a packet into a slot, truncating data to the slot size
+void kiss_copy_packet(kiss_packet_t *destination, const kiss_packet_t *source) {
+    size_t length = source->data_length;
+    if (length > destination->data_capacity) length = destination->data_capacity;
+    memcpy(destination->data, source->data, length);
+    destination->command = source->command;
+    destination->port = source->port;
+    destination->complete_packet = source->complete_packet;
+    destination->data_length = length;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,242 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "kiss_ring.h"
+#include "kiss_atomic.h"
+
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Create a ring using a buffer whose size is a power of two
+kiss_ring_t kiss_new_ring(uint8_t *buffer, size_t buffer_size) {
+    kiss_ring_t r = {
+        .buffer = buffer,
+        .mask = 0,
+        .head = 0,
+        .tail = 0,
+        .dropped = 0,
+        .mirrored = 0
+    };
+    if (buffer_size > 1 && (buffer_size & (buffer_size - 1)) == 0) {
+        r.mask = buffer_size - 1;
+    } else {
+        r.buffer = 0;
+    }
+    return r;
+}
+
+// Create a mirrored ring, returns 0 on success
+int kiss_new_mirrored_ring(kiss_ring_t *ring, size_t capacity) {
+#if defined(__linux__)
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = page_size;
+    while (size < capacity) size <<= 1;
+
+    int fd = memfd_create("kiss_ring", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Reserve space for both copies, then map the same memory into each half
+    uint8_t *base = mmap(0, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, size * 2);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    *ring = kiss_new_ring(base, size);
+    ring->mirrored = 1;
+    return 0;
+#else
+    (void) ring;
+    (void) capacity;
+    return -1;
+#endif
+}
+
+// Release the memory of a mirrored ring
+void kiss_free_mirrored_ring(kiss_ring_t *ring) {
+#if defined(__linux__)
+    if (ring->mirrored && ring->buffer) {
+        munmap(ring->buffer, (ring->mask + 1) * 2);
+    }
+#endif
+    ring->buffer = 0;
+    ring->mask = 0;
+    ring->mirrored = 0;
+}
+
+// Return the number of bytes waiting to be read
+size_t kiss_ring_length(const kiss_ring_t *ring) {
+    return KISS_LOAD_ACQUIRE(&ring->head) - KISS_LOAD_ACQUIRE(&ring->tail);
+}
+
+// Return the number of bytes that can be written
+size_t kiss_ring_space(const kiss_ring_t *ring) {
+    if (!ring->buffer) return 0;
+    return (ring->mask + 1) - kiss_ring_length(ring);
+}
+
+// Return where the producer can write next, and how many contiguous bytes fit there
+uint8_t* kiss_ring_write_ptr(kiss_ring_t *ring, size_t *available) {
+    size_t head = KISS_LOAD_RELAXED(&ring->head);
+    size_t offset = head & ring->mask;
+    size_t space = kiss_ring_space(ring);
+    if (!ring->mirrored && space > (ring->mask + 1) - offset) {
+        space = (ring->mask + 1) - offset;
+    }
+    *available = space;
+    return ring->buffer + offset;
+}
+
+// Make bytes written through kiss_ring_write_ptr visible to the consumer
+void kiss_ring_commit(kiss_ring_t *ring, size_t bytes) {
+    KISS_STORE_RELEASE(&ring->head, KISS_LOAD_RELAXED(&ring->head) + bytes);
+}
+
+// Copy bytes into the ring, returns bytes written
+size_t kiss_ring_write(kiss_ring_t *ring, const uint8_t *data, size_t data_size) {
+    size_t written = 0;
+    // At most two passes, one on each side of the wrap
+    for (int pass = 0; pass < 2 && written < data_size; pass++) {
+        size_t available;
+        uint8_t *p = kiss_ring_write_ptr(ring, &available);
+        if (available == 0) break;
+        if (available > data_size - written) available = data_size - written;
+        memcpy(p, data + written, available);
+        kiss_ring_commit(ring, available);
+        written += available;
+    }
+    ring->dropped += data_size - written;
+    return written;
+}
+
+// Return where the consumer can read next, and how many contiguous bytes are there
+uint8_t* kiss_ring_read_ptr(kiss_ring_t *ring, size_t *available) {
+    size_t tail = KISS_LOAD_RELAXED(&ring->tail);
+    size_t offset = tail & ring->mask;
+    size_t length = KISS_LOAD_ACQUIRE(&ring->head) - tail;
+    if (!ring->mirrored && length > (ring->mask + 1) - offset) {
+        length = (ring->mask + 1) - offset;
+    }
+    *available = length;
+    return ring->buffer + offset;
+}
+
+// Release bytes read through kiss_ring_read_ptr back to the producer
+void kiss_ring_consume(kiss_ring_t *ring, size_t bytes) {
+    KISS_STORE_RELEASE(&ring->tail, KISS_LOAD_RELAXED(&ring->tail) + bytes);
+}
+
+// Feed buffered bytes to a decoder, returns bytes consumed
+size_t kiss_ring_decode(kiss_ring_t *ring, kiss_decoder_t *decoder) {
+    size_t consumed = 0;
+    // At most two passes, one on each side of the wrap
+    for (int pass = 0; pass < 2; pass++) {
+        size_t available;
+        uint8_t *p = kiss_ring_read_ptr(ring, &available);
+        if (available == 0) break;
+        size_t used = kiss_decoder_push(decoder, p, available);
+        kiss_ring_consume(ring, used);
+        consumed += used;
+        if (decoder->packet.complete_packet) break;
+    }
+    return consumed;
+}
+
+// Copy bytes into the ring at an offset from head without publishing them
+static void kiss_ring_store(kiss_ring_t *ring, size_t offset, const uint8_t *data, size_t size) {
+    size_t start = (KISS_LOAD_RELAXED(&ring->head) + offset) & ring->mask;
+    size_t first = (ring->mask + 1) - start;
+    if (first > size) first = size;
+    memcpy(ring->buffer + start, data, first);
+    memcpy(ring->buffer, data + first, size - first);
+}
+
+// Copy bytes out of the ring at an offset from tail without releasing them
+static void kiss_ring_load(kiss_ring_t *ring, size_t offset, uint8_t *data, size_t size) {
+    size_t start = (KISS_LOAD_RELAXED(&ring->tail) + offset) & ring->mask;
+    size_t first = (ring->mask + 1) - start;
+    if (first > size) first = size;
+    memcpy(data, ring->buffer + start, first);
+    memcpy(data + first, ring->buffer, size - first);
+}
+
+// Queue a whole packet as one record
+uint8_t kiss_ring_put_packet(kiss_ring_t *ring, const kiss_packet_t *packet) {
+    if (packet->data_length > 0xFFFF) return 0;
+    if (kiss_ring_space(ring) < packet->data_length + 3) {
+        ring->dropped += packet->data_length + 3;
+        return 0;
+    }
+    uint8_t header[3] = {
+        kiss_encode_command(packet->command, packet->port),
+        (uint8_t) (packet->data_length & 0xFF),
+        (uint8_t) (packet->data_length >> 8)
+    };
+    kiss_ring_store(ring, 0, header, sizeof(header));
+    kiss_ring_store(ring, sizeof(header), packet->data, packet->data_length);
+    // The consumer sees the whole record at once
+    kiss_ring_commit(ring, packet->data_length + 3);
+    return 1;
+}
+
+// Take the next packet record
+uint8_t kiss_ring_get_packet(kiss_ring_t *ring, kiss_packet_t *packet) {
+    uint8_t header[3];
+    if (kiss_ring_length(ring) < sizeof(header)) return 0;
+    kiss_ring_load(ring, 0, header, sizeof(header));
+    size_t length = header[1] | ((size_t) header[2] << 8);
+
+    kiss_decode_command(header[0], &(packet->command), &(packet->port));
+    packet->complete_packet = 1;
+    packet->data_length = (length < packet->data_capacity) ? length : packet->data_capacity;
+    kiss_ring_load(ring, sizeof(header), packet->data, packet->data_length);
+    kiss_ring_consume(ring, length + sizeof(header));
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
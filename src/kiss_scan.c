@@ -0,0 +1,204 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * Scanners that find the next FEND or FESC byte in a buffer.
+ *
+ * Those are the only bytes that need escaping, and they are rare in real
+ * traffic, so the encoder and decoder use these to find the next byte that
+ * needs attention and copy everything before it in bulk.
+ *
+ * A portable word-at-a-time (SWAR) scanner is always available. On x86 the
+ * SSE2 and AVX2 scanners are used when the CPU supports them, and on ARM the
+ * NEON scanner is used when the compiler targets it. The choice is made once,
+ * either by kiss_init() or by the first call to kiss_find_special(). Threads
+ * may race to make it, they all store the same choice, atomically.
+ */
+
+#include "kiss.h"
+#include "kiss_atomic.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KISS_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define KISS_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Byte by byte, used for short tails
+static inline size_t kiss_find_special_tail(const uint8_t *buffer, size_t i, size_t buffer_size) {
+    for (; i < buffer_size; i++) {
+        uint8_t b = buffer[i];
+        if (b == KISS_FRAME_END || b == KISS_FRAME_ESCAPE) break;
+    }
+    return i;
+}
+
+// Portable scanner that checks a machine word at a time
+static size_t kiss_find_special_swar(const uint8_t *buffer, size_t buffer_size) {
+    const size_t ones = ((size_t) -1) / 0xFF;
+    const size_t highs = ones << 7;
+    const size_t fend = ones * KISS_FRAME_END;
+    const size_t fesc = ones * KISS_FRAME_ESCAPE;
+    size_t i = 0;
+
+    while (i + sizeof(size_t) <= buffer_size) {
+        size_t v;
+        memcpy(&v, buffer + i, sizeof(v));
+        size_t a = v ^ fend;
+        size_t b = v ^ fesc;
+        // Non-zero if any byte of a or b is zero
+        if ((((a - ones) & ~a) | ((b - ones) & ~b)) & highs) {
+            return kiss_find_special_tail(buffer, i, i + sizeof(size_t));
+        }
+        i += sizeof(size_t);
+    }
+    return kiss_find_special_tail(buffer, i, buffer_size);
+}
+
+#ifdef KISS_SCAN_X86
+
+__attribute__((target("sse2")))
+static size_t kiss_find_special_sse2(const uint8_t *buffer, size_t buffer_size) {
+    const __m128i fend = _mm_set1_epi8((char) KISS_FRAME_END);
+    const __m128i fesc = _mm_set1_epi8((char) KISS_FRAME_ESCAPE);
+    size_t i = 0;
+
+    while (i + 16 <= buffer_size) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (buffer + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, fend), _mm_cmpeq_epi8(v, fesc));
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(m);
+        if (mask) return i + __builtin_ctz(mask);
+        i += 16;
+    }
+    return kiss_find_special_tail(buffer, i, buffer_size);
+}
+
+__attribute__((target("avx2")))
+static size_t kiss_find_special_avx2(const uint8_t *buffer, size_t buffer_size) {
+    const __m256i fend = _mm256_set1_epi8((char) KISS_FRAME_END);
+    const __m256i fesc = _mm256_set1_epi8((char) KISS_FRAME_ESCAPE);
+    size_t i = 0;
+
+    while (i + 32 <= buffer_size) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (buffer + i));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, fend), _mm256_cmpeq_epi8(v, fesc));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+        if (mask) return i + __builtin_ctz(mask);
+        i += 32;
+    }
+    return i + kiss_find_special_sse2(buffer + i, buffer_size - i);
+}
+
+#endif // KISS_SCAN_X86
+
+#ifdef KISS_SCAN_NEON
+
+static size_t kiss_find_special_neon(const uint8_t *buffer, size_t buffer_size) {
+    const uint8x16_t fend = vdupq_n_u8(KISS_FRAME_END);
+    const uint8x16_t fesc = vdupq_n_u8(KISS_FRAME_ESCAPE);
+    size_t i = 0;
+
+    while (i + 16 <= buffer_size) {
+        uint8x16_t v = vld1q_u8(buffer + i);
+        uint8x16_t m = vorrq_u8(vceqq_u8(v, fend), vceqq_u8(v, fesc));
+        // Narrow each byte of the match mask to 4 bits so it fits in 64 bits
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+        if (mask) return i + (__builtin_ctzll(mask) >> 2);
+        i += 16;
+    }
+    return kiss_find_special_tail(buffer, i, buffer_size);
+}
+
+#endif // KISS_SCAN_NEON
+
+static const char *kiss_scan_name = "unselected";
+
+static size_t kiss_find_special_resolve(const uint8_t *buffer, size_t buffer_size);
+
+static kiss_scan_fn_t kiss_find_special_impl = kiss_find_special_resolve;
+
+// Pick the fastest scanner for this CPU
+void kiss_init(void) {
+    kiss_scan_fn_t fn = kiss_find_special_swar;
+    const char *name = "swar";
+#if defined(KISS_SCAN_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fn = kiss_find_special_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        fn = kiss_find_special_sse2;
+        name = "sse2";
+    }
+#elif defined(KISS_SCAN_NEON)
+    fn = kiss_find_special_neon;
+    name = "neon";
+#endif
+    // The name is published before the scanner, so whoever sees the scanner sees its name
+    KISS_STORE_RELEASE(&kiss_scan_name, name);
+    KISS_STORE_RELEASE(&kiss_find_special_impl, fn);
+}
+
+static size_t kiss_find_special_resolve(const uint8_t *buffer, size_t buffer_size) {
+    kiss_init();
+    return KISS_LOAD_ACQUIRE(&kiss_find_special_impl)(buffer, buffer_size);
+}
+
+// Return the name of the scanner in use
+const char* kiss_scan_implementation(void) {
+    if (KISS_LOAD_ACQUIRE(&kiss_find_special_impl) == kiss_find_special_resolve) kiss_init();
+    return KISS_LOAD_ACQUIRE(&kiss_scan_name);
+}
+
+// Return the index of the first FEND or FESC byte, or buffer_size if there is none
+size_t kiss_find_special(const uint8_t *buffer, size_t buffer_size) {
+    // Only the function is read, nothing else needs ordering against it
+    return KISS_LOAD_RELAXED(&kiss_find_special_impl)(buffer, buffer_size);
+}
+
+// Return a scanner by name, or 0 if it is not built in or this CPU lacks it
+kiss_scan_fn_t kiss_scan_get(const char *name) {
+    if (strcmp(name, "swar") == 0) return kiss_find_special_swar;
+#if defined(KISS_SCAN_X86)
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) return kiss_find_special_sse2;
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) return kiss_find_special_avx2;
+#elif defined(KISS_SCAN_NEON)
+    if (strcmp(name, "neon") == 0) return kiss_find_special_neon;
+#endif
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
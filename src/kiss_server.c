@@ -0,0 +1,471 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "kiss_server.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// epoll tags for the listening socket and the TNC, clients are numbered after them
+#define KISS_SERVER_TAG_LISTEN  0
+#define KISS_SERVER_TAG_TNC     1
+#define KISS_SERVER_TAG_CLIENT  2
+
+static size_t kiss_server_power_of_two(size_t n) {
+    size_t size = 2;
+    while (size < n) size <<= 1;
+    return size;
+}
+
+// Return options with the usual port and sizes suited to AX.25
+kiss_server_options_t kiss_new_server_options(void) {
+    kiss_server_options_t options = {
+        .port = KISS_SERVER_PORT,
+        .packet_size = KISS_POOL_AX25_SIZE * 2,
+        .queue_size = 256,
+        .buffers = 1024,
+        .max_clients = 64,
+        .tnc_buffer_size = 16384
+    };
+    return options;
+}
+
+// Change the events epoll reports for a file descriptor
+static int kiss_server_watch(kiss_server_t *server, int op, int fd, uint32_t events, uint64_t tag) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = tag;
+    return epoll_ctl(server->epoll_fd, op, fd, &event);
+}
+
+// Start listening for clients
+int kiss_server_init(kiss_server_t *server, const kiss_server_options_t *options) {
+    memset(server, 0, sizeof(*server));
+    server->options = *options;
+    server->options.queue_size = kiss_server_power_of_two(options->queue_size);
+    server->options.tnc_buffer_size = kiss_server_power_of_two(options->tnc_buffer_size);
+    server->listen_fd = -1;
+    server->tnc_fd = -1;
+    server->epoll_fd = -1;
+
+    // Shared buffers hold whole encoded frames, with every data byte and the command byte escaped
+    size_t encoded_size = options->packet_size * 2 + 4;
+    size_t arena_size = kiss_pool_arena_size(&encoded_size, &options->buffers, 1);
+    uint8_t *tnc_out = malloc(server->options.tnc_buffer_size);
+    uint8_t *tnc_packet = malloc(options->packet_size);
+    server->arena = malloc(arena_size);
+    server->scratch = malloc(encoded_size);
+    server->clients = calloc(options->max_clients, sizeof(kiss_server_client_t));
+    // Mark every slot empty before anything can fail, kiss_server_free drops clients with an fd
+    if (server->clients) {
+        for (size_t i = 0; i < options->max_clients; i++) server->clients[i].fd = -1;
+    }
+    server->tnc_out = kiss_new_ring(tnc_out, server->options.tnc_buffer_size);
+    server->tnc_decoder = kiss_new_decoder(tnc_packet, options->packet_size);
+    if (!tnc_out || !tnc_packet || !server->arena || !server->scratch || !server->clients) goto fail;
+    if (kiss_pool_init(&server->pool, server->arena, arena_size, &encoded_size, &options->buffers, 1) != 0) goto fail;
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server->epoll_fd < 0) goto fail;
+
+    server->listen_fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) goto fail;
+    int on = 1, off = 0;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    // Accept IPv4 clients on the same socket
+    setsockopt(server->listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    struct sockaddr_in6 address;
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(options->port);
+    if (bind(server->listen_fd, (struct sockaddr *) &address, sizeof(address)) < 0) goto fail;
+    if (listen(server->listen_fd, SOMAXCONN) < 0) goto fail;
+    if (kiss_server_watch(server, EPOLL_CTL_ADD, server->listen_fd, EPOLLIN, KISS_SERVER_TAG_LISTEN) < 0) goto fail;
+    return 0;
+
+fail:
+    kiss_server_free(server);
+    return -1;
+}
+
+// Return the TCP port the server is listening on
+uint16_t kiss_server_port(const kiss_server_t *server) {
+    struct sockaddr_in6 address;
+    socklen_t length = sizeof(address);
+    if (getsockname(server->listen_fd, (struct sockaddr *) &address, &length) < 0) return 0;
+    return ntohs(address.sin6_port);
+}
+
+// Read frames from a TNC and send them to every client, and write client frames to it
+int kiss_server_set_tnc(kiss_server_t *server, int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return -1;
+    if (kiss_server_watch(server, EPOLL_CTL_ADD, fd, EPOLLIN, KISS_SERVER_TAG_TNC) < 0) return -1;
+    server->tnc_fd = fd;
+    return 0;
+}
+
+// Call handler for every frame a client sends
+void kiss_server_set_inbound(kiss_server_t *server, kiss_handler_t handler, void *context) {
+    server->inbound = handler;
+    server->inbound_context = context;
+}
+
+// Change the events a client is watched for, only calling epoll when they differ
+static void kiss_server_client_events(kiss_server_t *server, size_t index, uint32_t events) {
+    kiss_server_client_t *c = &server->clients[index];
+    if (c->events == events) return;
+    kiss_server_watch(server, EPOLL_CTL_MOD, c->fd, events, KISS_SERVER_TAG_CLIENT + index);
+    c->events = events;
+}
+
+// Disconnect a client and release everything it holds
+static void kiss_server_drop_client(kiss_server_t *server, size_t index) {
+    kiss_server_client_t *c = &server->clients[index];
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, c->fd, 0);
+    close(c->fd);
+    while (c->head != c->tail) kiss_pool_release(c->queue[c->head++ & c->mask]);
+    free(c->queue);
+    free(c->input);
+    free(c->decoder.packet.data);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    server->client_count--;
+}
+
+// Accept every waiting client
+static void kiss_server_accept(kiss_server_t *server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        size_t index = 0;
+        while (index < server->options.max_clients && server->clients[index].fd >= 0) index++;
+        if (index == server->options.max_clients) {
+            server->stats.rejected++;
+            close(fd);
+            continue;
+        }
+
+        kiss_server_client_t *c = &server->clients[index];
+        c->queue = malloc(server->options.queue_size * sizeof(kiss_packet_t *));
+        c->input = malloc(KISS_SERVER_INPUT_SIZE);
+        uint8_t *packet = malloc(server->options.packet_size);
+        if (!c->queue || !c->input || !packet ||
+                kiss_server_watch(server, EPOLL_CTL_ADD, fd, EPOLLIN, KISS_SERVER_TAG_CLIENT + index) < 0) {
+            free(c->queue);
+            free(c->input);
+            free(packet);
+            memset(c, 0, sizeof(*c));
+            c->fd = -1;
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        c->mask = server->options.queue_size - 1;
+        c->decoder = kiss_new_decoder(packet, server->options.packet_size);
+        server->client_count++;
+        server->stats.accepted++;
+    }
+}
+
+// Encode a frame once and queue it for every client
+int kiss_server_broadcast(kiss_server_t *server, const kiss_packet_t *packet) {
+    kiss_packet_t *encoded = kiss_pool_alloc(&server->pool, kiss_encoded_length(packet));
+    if (!encoded) {
+        server->stats.dropped++;
+        return -1;
+    }
+    encoded->data_length = kiss_encode_packet(*packet, encoded->data, encoded->data_capacity);
+    if (encoded->data_length == 0) {
+        // Bigger than the packet size the server was set up for
+        kiss_pool_release(encoded);
+        server->stats.dropped++;
+        return -1;
+    }
+
+    for (size_t i = 0; i < server->options.max_clients; i++) {
+        kiss_server_client_t *c = &server->clients[i];
+        if (c->fd < 0) continue;
+        if (c->tail - c->head > c->mask) {
+            // Too slow to keep up, do not let it hold on to shared buffers
+            server->stats.evicted++;
+            kiss_server_drop_client(server, i);
+            continue;
+        }
+        kiss_pool_retain(encoded);
+        c->queue[c->tail++ & c->mask] = encoded;
+    }
+
+    kiss_pool_release(encoded);
+    server->stats.broadcast++;
+    return 0;
+}
+
+// Send as much of a client's queue as the socket takes
+static void kiss_server_flush_client(kiss_server_t *server, size_t index) {
+    kiss_server_client_t *c = &server->clients[index];
+    while (c->head != c->tail) {
+        struct iovec iov[KISS_SERVER_MAX_IOV];
+        size_t count = 0;
+        size_t total = 0;
+        for (size_t i = c->head; i != c->tail && count < KISS_SERVER_MAX_IOV; i++, count++) {
+            kiss_packet_t *p = c->queue[i & c->mask];
+            size_t skip = (i == c->head) ? c->offset : 0;
+            iov[count].iov_base = p->data + skip;
+            iov[count].iov_len = p->data_length - skip;
+            total += iov[count].iov_len;
+        }
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(c->fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            server->stats.disconnected++;
+            kiss_server_drop_client(server, index);
+            return;
+        }
+
+        // Release every frame that went out completely
+        size_t left = (size_t) sent;
+        while (left > 0) {
+            kiss_packet_t *p = c->queue[c->head & c->mask];
+            size_t remaining = p->data_length - c->offset;
+            if (left < remaining) {
+                c->offset += left;
+                break;
+            }
+            left -= remaining;
+            c->offset = 0;
+            c->head++;
+            kiss_pool_release(p);
+        }
+        // A short write means the socket buffer is full
+        if ((size_t) sent < total) break;
+    }
+
+    // Only ask to hear about writability while there is something to write
+    uint32_t events = c->blocked ? 0 : EPOLLIN;
+    if (c->head != c->tail) events |= EPOLLOUT;
+    kiss_server_client_events(server, index, events);
+}
+
+// Queue a client frame for the TNC, returns 0 on success or -1 if there is no room yet
+static int kiss_server_forward(kiss_server_t *server, const kiss_packet_t *packet) {
+    if (server->tnc_fd >= 0) {
+        size_t length = kiss_encode_packet(*packet, server->scratch, server->options.packet_size * 2 + 4);
+        if (length == 0) {
+            // Too big to encode, waiting for room would not help
+            server->stats.dropped++;
+            return 0;
+        }
+        if (kiss_ring_space(&server->tnc_out) < length) return -1;
+        kiss_ring_write(&server->tnc_out, server->scratch, length);
+    }
+    server->stats.inbound++;
+    if (server->inbound) server->inbound(packet, server->inbound_context);
+    return 0;
+}
+
+// Decode what a client has sent, returns -1 if it blocked on a full TNC buffer
+static int kiss_server_client_decode(kiss_server_t *server, size_t index) {
+    kiss_server_client_t *c = &server->clients[index];
+    if (c->blocked) {
+        if (kiss_server_forward(server, &c->decoder.packet) < 0) return -1;
+        c->blocked = 0;
+    }
+    while (c->input_start < c->input_end) {
+        c->input_start += kiss_decoder_push(&c->decoder, c->input + c->input_start, c->input_end - c->input_start);
+        if (c->decoder.packet.complete_packet && kiss_server_forward(server, &c->decoder.packet) < 0) {
+            c->blocked = 1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Read and decode what a client has sent
+static void kiss_server_read_client(kiss_server_t *server, size_t index) {
+    kiss_server_client_t *c = &server->clients[index];
+    if (c->blocked) return;
+    ssize_t n = recv(c->fd, c->input, KISS_SERVER_INPUT_SIZE, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    if (n <= 0) {
+        server->stats.disconnected++;
+        kiss_server_drop_client(server, index);
+        return;
+    }
+    c->input_start = 0;
+    c->input_end = (size_t) n;
+    if (kiss_server_client_decode(server, index) < 0) {
+        // Stop reading until the TNC catches up, TCP will hold the client back
+        kiss_server_client_events(server, index, c->events & ~EPOLLIN);
+    }
+}
+
+// Give blocked clients one frame each in turn while the TNC buffer has room
+static void kiss_server_arbitrate(kiss_server_t *server) {
+    size_t clients = server->options.max_clients;
+    size_t start = server->next_client;
+    for (size_t n = 0; n < clients; n++) {
+        size_t index = (start + n) % clients;
+        kiss_server_client_t *c = &server->clients[index];
+        if (c->fd < 0 || !c->blocked) continue;
+        if (kiss_server_forward(server, &c->decoder.packet) < 0) {
+            // This client goes first next time
+            server->next_client = index;
+            return;
+        }
+        c->blocked = 0;
+        if (kiss_server_client_decode(server, index) == 0) {
+            kiss_server_client_events(server, index, c->events | EPOLLIN);
+        }
+    }
+    server->next_client = (start + 1) % clients;
+}
+
+// Read frames from the TNC and broadcast them
+static void kiss_server_read_tnc(kiss_server_t *server) {
+    uint8_t buffer[KISS_SERVER_INPUT_SIZE];
+    ssize_t n = read(server->tnc_fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+        // The TNC went away, keep serving clients without it
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, server->tnc_fd, 0);
+        server->tnc_fd = -1;
+        return;
+    }
+    size_t offset = 0;
+    while (offset < (size_t) n) {
+        offset += kiss_decoder_push(&server->tnc_decoder, buffer + offset, (size_t) n - offset);
+        if (server->tnc_decoder.packet.complete_packet) kiss_server_broadcast(server, &server->tnc_decoder.packet);
+    }
+}
+
+// Write queued client frames to the TNC
+static void kiss_server_flush_tnc(kiss_server_t *server) {
+    if (server->tnc_fd < 0) return;
+    while (kiss_ring_length(&server->tnc_out) > 0) {
+        size_t available;
+        uint8_t *p = kiss_ring_read_ptr(&server->tnc_out, &available);
+        ssize_t n = write(server->tnc_fd, p, available);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        kiss_ring_consume(&server->tnc_out, (size_t) n);
+    }
+    uint8_t writing = kiss_ring_length(&server->tnc_out) > 0;
+    if (writing != server->tnc_writing) {
+        kiss_server_watch(server, EPOLL_CTL_MOD, server->tnc_fd, writing ? EPOLLIN | EPOLLOUT : EPOLLIN, KISS_SERVER_TAG_TNC);
+        server->tnc_writing = writing;
+    }
+}
+
+// Wait up to timeout_ms for activity and handle it
+int kiss_server_run_once(kiss_server_t *server, int timeout_ms) {
+    int count = epoll_wait(server->epoll_fd, server->events, KISS_SERVER_MAX_EVENTS, timeout_ms);
+    if (count < 0) return (errno == EINTR) ? 0 : -1;
+
+    for (int i = 0; i < count; i++) {
+        uint64_t tag = server->events[i].data.u64;
+        uint32_t events = server->events[i].events;
+        if (tag == KISS_SERVER_TAG_LISTEN) {
+            kiss_server_accept(server);
+        } else if (tag == KISS_SERVER_TAG_TNC) {
+            if (server->tnc_fd >= 0 && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) kiss_server_read_tnc(server);
+        } else {
+            size_t index = tag - KISS_SERVER_TAG_CLIENT;
+            // The client may have been dropped by an earlier event in this batch
+            if (server->clients[index].fd < 0) continue;
+            if (server->clients[index].blocked && (events & (EPOLLHUP | EPOLLERR))) {
+                // Gone while its frame was waiting for the TNC
+                server->stats.disconnected++;
+                kiss_server_drop_client(server, index);
+            } else if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                kiss_server_read_client(server, index);
+            }
+        }
+    }
+
+    // Client frames go out before new ones are let in
+    kiss_server_flush_tnc(server);
+    kiss_server_arbitrate(server);
+    kiss_server_flush_tnc(server);
+
+    // One vectored write per client for everything broadcast this turn
+    for (size_t i = 0; i < server->options.max_clients; i++) {
+        if (server->clients[i].fd >= 0) kiss_server_flush_client(server, i);
+    }
+    return 0;
+}
+
+// Disconnect every client and release all memory
+void kiss_server_free(kiss_server_t *server) {
+    if (server->clients) {
+        for (size_t i = 0; i < server->options.max_clients; i++) {
+            if (server->clients[i].fd >= 0) kiss_server_drop_client(server, i);
+        }
+    }
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    free(server->clients);
+    free(server->arena);
+    free(server->scratch);
+    free(server->tnc_out.buffer);
+    free(server->tnc_decoder.packet.data);
+    server->clients = 0;
+    server->arena = 0;
+    server->scratch = 0;
+    server->tnc_out.buffer = 0;
+    server->tnc_decoder.packet.data = 0;
+    server->listen_fd = -1;
+    server->epoll_fd = -1;
+    server->tnc_fd = -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
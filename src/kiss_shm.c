@@ -0,0 +1,260 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "kiss_shm.h"
+
+#if defined(__linux__)
+
+#include "kiss_atomic.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static kiss_shm_slot_t* kiss_shm_slot(const kiss_shm_t *shm, uint64_t sequence) {
+    const kiss_shm_header_t *h = shm->header;
+    return (kiss_shm_slot_t *) (shm->slots + (sequence & (h->slot_count - 1)) * h->slot_stride);
+}
+
+// Map a ring and check that it is one
+static int kiss_shm_map(kiss_shm_t *shm, int fd, size_t size) {
+    void *base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return -1;
+    shm->header = base;
+    shm->slots = (uint8_t *) base + sizeof(kiss_shm_header_t);
+    shm->size = size;
+    shm->fd = fd;
+    return 0;
+}
+
+// Create a ring of slot_count slots holding slot_size bytes each
+int kiss_shm_create(kiss_shm_t *shm, const char *name, size_t slot_count, size_t slot_size) {
+    size_t count = 2;
+    while (count < slot_count) count <<= 1;
+    size_t stride = (sizeof(kiss_shm_slot_t) + slot_size + KISS_CACHE_LINE - 1) & ~((size_t) KISS_CACHE_LINE - 1);
+    size_t size = sizeof(kiss_shm_header_t) + count * stride;
+
+    int fd = name ? shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600) : memfd_create("kiss_shm", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t) size) < 0 || kiss_shm_map(shm, fd, size) < 0) {
+        close(fd);
+        if (name) shm_unlink(name);
+        return -1;
+    }
+
+    // The new mapping is zero filled, so every slot starts at sequence 0
+    kiss_shm_header_t *h = shm->header;
+    h->version = KISS_SHM_VERSION;
+    h->slot_count = count;
+    h->slot_size = slot_size;
+    h->slot_stride = stride;
+    // Readers check the magic last
+    KISS_STORE_RELEASE(&h->magic, KISS_SHM_MAGIC);
+    return 0;
+}
+
+// Map a ring from a file descriptor
+int kiss_shm_attach(kiss_shm_t *shm, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(kiss_shm_header_t)) return -1;
+    if (kiss_shm_map(shm, fd, (size_t) st.st_size) < 0) return -1;
+    const kiss_shm_header_t *h = shm->header;
+    if (KISS_LOAD_ACQUIRE(&h->magic) != KISS_SHM_MAGIC || h->version != KISS_SHM_VERSION ||
+            sizeof(kiss_shm_header_t) + h->slot_count * h->slot_stride > shm->size) {
+        munmap(shm->header, shm->size);
+        shm->header = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Map a ring created by another process under a name
+int kiss_shm_open(kiss_shm_t *shm, const char *name) {
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (kiss_shm_attach(shm, fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+// Unmap a ring and close its file descriptor
+void kiss_shm_close(kiss_shm_t *shm) {
+    if (shm->header) munmap(shm->header, shm->size);
+    if (shm->fd >= 0) close(shm->fd);
+    shm->header = 0;
+    shm->slots = 0;
+    shm->fd = -1;
+}
+
+// Return a packet whose data is the next slot
+kiss_packet_t kiss_shm_begin_write(kiss_shm_t *shm) {
+    kiss_shm_header_t *h = shm->header;
+    uint64_t head = h->head;
+    kiss_shm_slot_t *slot = kiss_shm_slot(shm, head);
+    // Mark the slot as being written before touching its data
+    KISS_STORE_RELAXED(&slot->sequence, head * 2 + 1);
+    KISS_FENCE_RELEASE();
+    return kiss_new_packet((uint8_t *) (slot + 1), h->slot_size);
+}
+
+// Publish the packet returned by kiss_shm_begin_write and wake waiting readers
+void kiss_shm_end_write(kiss_shm_t *shm, const kiss_packet_t *packet) {
+    kiss_shm_header_t *h = shm->header;
+    uint64_t head = h->head;
+    kiss_shm_slot_t *slot = kiss_shm_slot(shm, head);
+    slot->command = (uint8_t) packet->command;
+    slot->port = packet->port;
+    slot->length = (uint32_t) packet->data_length;
+    KISS_STORE_RELEASE(&slot->sequence, head * 2 + 2);
+    KISS_STORE_RELEASE(&h->head, head + 1);
+
+    // Pairs with the fence in kiss_shm_wait, either we see the waiter or it sees the new head
+    KISS_FENCE();
+    if (KISS_LOAD_RELAXED(&h->waiters)) {
+        KISS_FETCH_ADD(&h->futex, 1);
+        syscall(SYS_futex, &h->futex, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+    }
+}
+
+// Copy a packet into the next slot and publish it
+int kiss_shm_write(kiss_shm_t *shm, const kiss_packet_t *packet) {
+    if (packet->data_length > shm->header->slot_size) return -1;
+    kiss_packet_t slot = kiss_shm_begin_write(shm);
+    memcpy(slot.data, packet->data, packet->data_length);
+    slot.command = packet->command;
+    slot.port = packet->port;
+    slot.data_length = packet->data_length;
+    kiss_shm_end_write(shm, &slot);
+    return 0;
+}
+
+// Create a reader that starts with the next frame published
+kiss_shm_reader_t kiss_new_shm_reader(kiss_shm_t *shm) {
+    kiss_shm_reader_t reader = {
+        .shm = shm,
+        .cursor = KISS_LOAD_ACQUIRE(&shm->header->head),
+        .overruns = 0
+    };
+    return reader;
+}
+
+// Skip past frames that have been overwritten
+static void kiss_shm_overrun(kiss_shm_reader_t *reader, uint64_t head) {
+    uint64_t count = reader->shm->header->slot_count;
+    // Leave half the ring as a margin, the writer is still moving
+    uint64_t cursor = (head > count / 2) ? head - count / 2 : 0;
+    if (cursor <= reader->cursor) cursor = reader->cursor + 1;
+    reader->overruns += cursor - reader->cursor;
+    reader->cursor = cursor;
+}
+
+// Point packet at the next frame in shared memory without copying
+int kiss_shm_peek(kiss_shm_reader_t *reader, kiss_packet_t *packet) {
+    kiss_shm_t *shm = reader->shm;
+    uint64_t head = KISS_LOAD_ACQUIRE(&shm->header->head);
+    if (reader->cursor == head) return 0;
+    if (head - reader->cursor > shm->header->slot_count) {
+        kiss_shm_overrun(reader, head);
+        return -1;
+    }
+    kiss_shm_slot_t *slot = kiss_shm_slot(shm, reader->cursor);
+    if (KISS_LOAD_ACQUIRE(&slot->sequence) != reader->cursor * 2 + 2) {
+        kiss_shm_overrun(reader, head);
+        return -1;
+    }
+    packet->command = (kiss_command_t) slot->command;
+    packet->port = slot->port;
+    packet->data = (uint8_t *) (slot + 1);
+    packet->data_length = slot->length;
+    packet->data_capacity = slot->length;
+    packet->complete_packet = 1;
+    return 1;
+}
+
+// Move past a peeked frame
+int kiss_shm_release(kiss_shm_reader_t *reader) {
+    kiss_shm_slot_t *slot = kiss_shm_slot(reader->shm, reader->cursor);
+    // Everything read from the slot must be done before the sequence is checked again
+    KISS_FENCE_ACQUIRE();
+    uint64_t sequence = KISS_LOAD_RELAXED(&slot->sequence);
+    reader->cursor++;
+    if (sequence != reader->cursor * 2) {
+        reader->overruns++;
+        return -1;
+    }
+    return 0;
+}
+
+// Copy the next frame into packet
+int kiss_shm_read(kiss_shm_reader_t *reader, kiss_packet_t *packet) {
+    kiss_packet_t shared;
+    int result = kiss_shm_peek(reader, &shared);
+    if (result <= 0) return result;
+    size_t length = (shared.data_length < packet->data_capacity) ? shared.data_length : packet->data_capacity;
+    memcpy(packet->data, shared.data, length);
+    packet->command = shared.command;
+    packet->port = shared.port;
+    packet->data_length = length;
+    packet->complete_packet = 1;
+    return (kiss_shm_release(reader) == 0) ? 1 : -1;
+}
+
+// Sleep until a frame is available or timeout_ms passes
+int kiss_shm_wait(kiss_shm_reader_t *reader, int timeout_ms) {
+    kiss_shm_header_t *h = reader->shm->header;
+    if (KISS_LOAD_ACQUIRE(&h->head) != reader->cursor) return 1;
+    if (timeout_ms == 0) return 0;
+
+    struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    KISS_FETCH_ADD(&h->waiters, 1);
+    KISS_FENCE();
+    uint32_t futex = KISS_LOAD_RELAXED(&h->futex);
+    if (KISS_LOAD_ACQUIRE(&h->head) == reader->cursor) {
+        syscall(SYS_futex, &h->futex, FUTEX_WAIT, futex, timeout_ms < 0 ? 0 : &timeout, 0, 0);
+    }
+    KISS_FETCH_SUB(&h->waiters, 1);
+    return KISS_LOAD_ACQUIRE(&h->head) != reader->cursor;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
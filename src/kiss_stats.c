@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_stats.h"
+#include "kiss_atomic.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Reset all counters and histograms to zero
+void kiss_stats_init(kiss_stats_t *stats, uint8_t histograms) {
+    memset(stats, 0, sizeof(*stats));
+    stats->histograms = histograms;
+}
+
+// Copy the counters, safe to call while another thread is decoding
+void kiss_stats_snapshot(const kiss_stats_t *stats, kiss_stats_t *snapshot) {
+    // Every counter from bytes_in to the end of the histograms is a size_t,
+    // load them one at a time so none of them is torn
+    const size_t *src = &stats->bytes_in;
+    size_t *dst = &snapshot->bytes_in;
+    size_t count = (offsetof(kiss_stats_t, frame_start) - offsetof(kiss_stats_t, bytes_in)) / sizeof(size_t);
+
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = KISS_LOAD_RELAXED(&src[i]);
+    }
+    snapshot->now = stats->now;
+    snapshot->histograms = stats->histograms;
+    snapshot->frame_start = 0;
+    snapshot->frame_lost = 0;
+    snapshot->frame_in = 0;
+}
+
+// Return the histogram bucket for a value, the number of bits needed to hold it
+uint8_t kiss_stats_bucket(uint64_t value) {
+    uint8_t bucket;
+#if defined(__GNUC__)
+    bucket = value ? (uint8_t) (64 - __builtin_clzll(value)) : 0;
+#else
+    for (bucket = 0; value; bucket++) value >>= 1;
+#endif
+    return bucket < KISS_STATS_BUCKETS ? bucket : KISS_STATS_BUCKETS - 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
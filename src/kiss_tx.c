@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_tx.h"
+
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <sys/uio.h>
+#endif
+
+#define KISS_TX_NS_PER_SECOND   1000000000ULL
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Initialize a queue whose data buffer size is a power of two
+int kiss_tx_init(kiss_tx_t *tx, uint8_t *buffer, size_t buffer_size) {
+    memset(tx, 0, sizeof(*tx));
+    tx->data = kiss_new_ring(buffer, buffer_size);
+    tx->control = kiss_new_ring(tx->control_buffer, sizeof(tx->control_buffer));
+    return tx->data.buffer ? 0 : -1;
+}
+
+// Pace output to bits_per_second, never having more than burst bytes in the TNC
+void kiss_tx_set_rate(kiss_tx_t *tx, uint64_t bits_per_second, size_t burst, uint64_t now) {
+    tx->rate = bits_per_second / 8;
+    tx->burst = burst;
+    tx->tokens = burst;
+    tx->last = now;
+}
+
+// Top up the bucket for the time since the last call
+static void kiss_tx_refill(kiss_tx_t *tx, uint64_t now) {
+    uint64_t elapsed, added;
+
+    if (!tx->rate || now <= tx->last) return;
+    elapsed = now - tx->last;
+    if (tx->tokens >= tx->burst || elapsed >= (tx->burst - tx->tokens) * KISS_TX_NS_PER_SECOND / tx->rate) {
+        tx->tokens = tx->burst;
+        tx->last = now;
+        return;
+    }
+    added = elapsed * tx->rate / KISS_TX_NS_PER_SECOND;
+    tx->tokens += added;
+    // Keep the part of a byte that has not been earned yet
+    tx->last += added * KISS_TX_NS_PER_SECOND / tx->rate;
+}
+
+// Parameters that only the latest value of matters
+static inline int kiss_tx_is_parameter(const kiss_packet_t *p) {
+    return p->command >= KISS_TX_DELAY && p->command < KISS_SET_HARDWARE && p->data_length > 0;
+}
+
+// Escape bytes into a ring a run at a time
+static void kiss_tx_write_escaped(kiss_ring_t *ring, const uint8_t *data, size_t length) {
+    uint8_t escaped[2] = {KISS_FRAME_ESCAPE, 0};
+    size_t i = 0;
+
+    while (i < length) {
+        size_t run = kiss_find_special(data + i, length - i);
+        kiss_ring_write(ring, data + i, run);
+        i += run;
+        if (i < length) {
+            escaped[1] = (data[i++] == KISS_FRAME_END) ? KISS_ESCAPE_FEND : KISS_ESCAPE_FESC;
+            kiss_ring_write(ring, escaped, 2);
+        }
+    }
+}
+
+// Turn pending parameter updates into frames, as far as there is room for them
+static void kiss_tx_encode_parameters(kiss_tx_t *tx) {
+    uint8_t frame[5];
+    kiss_packet_t p;
+
+    for (uint8_t port = 0; port < KISS_PORTS; port++) {
+        if (!tx->pending[port]) continue;
+        for (uint8_t command = KISS_TX_DELAY; command < KISS_SET_HARDWARE; command++) {
+            uint16_t bit = (uint16_t) (1 << command);
+            if (!(tx->pending[port] & bit)) continue;
+            p = kiss_new_packet(&tx->values[port][command], 1);
+            p.data_length = 1;
+            p.command = (kiss_command_t) command;
+            p.port = port;
+            size_t length = kiss_encode_packet(p, frame, sizeof(frame));
+            if (length > kiss_ring_space(&tx->control)) return;
+            kiss_ring_write(&tx->control, frame, length);
+            tx->pending[port] &= (uint16_t) ~bit;
+            tx->known[port] |= bit;
+            tx->stats.parameters++;
+        }
+    }
+}
+
+// Queue a frame
+int kiss_tx_queue(kiss_tx_t *tx, const kiss_packet_t *p) {
+    const uint8_t fend = KISS_FRAME_END;
+    kiss_ring_t *ring = &tx->data;
+    uint8_t command;
+    size_t length;
+
+    if (kiss_tx_is_parameter(p)) {
+        uint8_t port = p->port & 0x0f;
+        uint16_t bit = (uint16_t) (1 << p->command);
+        if (tx->pending[port] & bit) {
+            // Replaces an update that has not been sent yet
+            tx->stats.deduplicated++;
+        } else if ((tx->known[port] & bit) && tx->values[port][p->command] == p->data[0]) {
+            // The TNC already has this value
+            tx->stats.deduplicated++;
+            return 0;
+        }
+        tx->values[port][p->command] = p->data[0];
+        tx->pending[port] |= bit;
+        return 0;
+    }
+
+    if (p->command == KISS_SET_HARDWARE || p->command == KISS_RETURN) {
+        // Parameter updates queued earlier go out first
+        kiss_tx_encode_parameters(tx);
+        ring = &tx->control;
+    }
+    // Data frames on port 12 have a command byte of FEND, so it is escaped like the data
+    command = kiss_encode_command(p->command, p->port);
+    length = kiss_encoded_length(p);
+    if (length > kiss_ring_space(ring)) {
+        tx->stats.dropped++;
+        return -1;
+    }
+    kiss_ring_write(ring, &fend, 1);
+    kiss_tx_write_escaped(ring, &command, 1);
+    kiss_tx_write_escaped(ring, p->data, p->data_length);
+    kiss_ring_write(ring, &fend, 1);
+    if (ring == &tx->data) tx->stats.frames++;
+    return 0;
+}
+
+// Forget which parameter values the TNC has
+void kiss_tx_reset_parameters(kiss_tx_t *tx) {
+    memset(tx->known, 0, sizeof(tx->known));
+}
+
+// Return the number of bytes waiting to be written
+size_t kiss_tx_length(const kiss_tx_t *tx) {
+    return kiss_ring_length(&tx->data) + kiss_ring_length(&tx->control);
+}
+
+// Add up to limit bytes of a ring, starting offset bytes in, as at most two buffers
+static size_t kiss_tx_add_iov(kiss_iovec_t *iov, size_t n, const kiss_ring_t *ring, size_t offset, size_t length) {
+    size_t start = (ring->tail + offset) & ring->mask;
+    size_t first = ring->mask + 1 - start;
+
+    if (length == 0) return n;
+    if (first > length) first = length;
+    iov[n].iov_base = ring->buffer + start;
+    iov[n++].iov_len = first;
+    if (length > first) {
+        iov[n].iov_base = ring->buffer;
+        iov[n++].iov_len = length - first;
+    }
+    return n;
+}
+
+// Return how many bytes at the start of the data ring finish the frame being written, including its FEND
+static size_t kiss_tx_rest_of_frame(const kiss_tx_t *tx) {
+    const kiss_ring_t *ring = &tx->data;
+    size_t length = kiss_ring_length(ring);
+    size_t start = ring->tail & ring->mask;
+    size_t first = ring->mask + 1 - start;
+    const uint8_t *fend;
+
+    if (!(tx->data_fends & 1)) return 0;
+    if (first > length) first = length;
+    fend = memchr(ring->buffer + start, KISS_FRAME_END, first);
+    if (fend) return (size_t) (fend - (ring->buffer + start)) + 1;
+    fend = memchr(ring->buffer, KISS_FRAME_END, length - first);
+    return fend ? first + (size_t) (fend - ring->buffer) + 1 : length;
+}
+
+// Fill iov with what can be written now
+size_t kiss_tx_prepare(kiss_tx_t *tx, kiss_iovec_t *iov, uint64_t now) {
+    size_t limit = (size_t) -1;
+    size_t n = 0;
+    size_t data_length, control_length, length;
+
+    kiss_tx_encode_parameters(tx);
+    if (tx->rate) {
+        kiss_tx_refill(tx, now);
+        limit = tx->tokens;
+    }
+    data_length = kiss_ring_length(&tx->data);
+
+    // Finish a partly written data frame, then the control frames, then the rest of the data
+    length = kiss_tx_rest_of_frame(tx);
+    if (length > limit) length = limit;
+    n = kiss_tx_add_iov(iov, n, &tx->data, 0, length);
+    tx->planned_first = length;
+    limit -= length;
+
+    control_length = kiss_ring_length(&tx->control);
+    if (control_length > limit) control_length = limit;
+    n = kiss_tx_add_iov(iov, n, &tx->control, 0, control_length);
+    tx->planned_control = control_length;
+    limit -= control_length;
+
+    length = data_length - tx->planned_first;
+    if (length > limit) length = limit;
+    n = kiss_tx_add_iov(iov, n, &tx->data, tx->planned_first, length);
+    return n;
+}
+
+// Release data bytes, keeping count of the FENDs among them
+static void kiss_tx_consume_data(kiss_tx_t *tx, size_t bytes) {
+    size_t available;
+    while (bytes > 0) {
+        uint8_t *data = kiss_ring_read_ptr(&tx->data, &available);
+        if (available > bytes) available = bytes;
+        for (const uint8_t *end = data + available; (data = memchr(data, KISS_FRAME_END, end - data)) != 0; data++) {
+            tx->data_fends++;
+        }
+        kiss_ring_consume(&tx->data, available);
+        bytes -= available;
+    }
+}
+
+// Release bytes written from the buffers returned by the last kiss_tx_prepare
+void kiss_tx_consume(kiss_tx_t *tx, size_t bytes) {
+    size_t part;
+
+    tx->stats.bytes += bytes;
+    if (tx->rate) tx->tokens -= (bytes < tx->tokens) ? bytes : tx->tokens;
+
+    part = (bytes < tx->planned_first) ? bytes : tx->planned_first;
+    kiss_tx_consume_data(tx, part);
+    bytes -= part;
+    part = (bytes < tx->planned_control) ? bytes : tx->planned_control;
+    kiss_ring_consume(&tx->control, part);
+    bytes -= part;
+    kiss_tx_consume_data(tx, bytes);
+    tx->planned_first = 0;
+    tx->planned_control = 0;
+}
+
+// Return how long until more can be written
+uint64_t kiss_tx_delay(const kiss_tx_t *tx, uint64_t now) {
+    size_t waiting = kiss_tx_length(tx);
+    uint64_t tokens = tx->tokens;
+    size_t need;
+
+    if (!tx->rate || waiting == 0) return 0;
+    // Wait until everything waiting, or a whole bucket of it, can go in one write
+    need = (waiting < tx->burst) ? waiting : tx->burst;
+    if (now > tx->last) tokens += (now - tx->last) * tx->rate / KISS_TX_NS_PER_SECOND;
+    if (tokens >= need) return 0;
+    return ((need - tokens) * KISS_TX_NS_PER_SECOND + tx->rate - 1) / tx->rate;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Write what the rate allows to fd with one writev()
+ssize_t kiss_tx_flush(kiss_tx_t *tx, int fd, uint64_t now) {
+    kiss_iovec_t iov[KISS_TX_MAX_IOV];
+    size_t count = kiss_tx_prepare(tx, iov, now);
+    ssize_t written;
+
+    if (count == 0) return 0;
+    do {
+        written = writev(fd, iov, (int) count);
+    } while (written < 0 && errno == EINTR);
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+    kiss_tx_consume(tx, (size_t) written);
+    tx->stats.writes++;
+    return written;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
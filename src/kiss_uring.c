@@ -0,0 +1,676 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "kiss_uring.h"
+
+#if defined(__linux__)
+
+#include "kiss_atomic.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Provided buffer rings arrived with kernel 5.19, the headers have no macro for them, so use one from the same era
+#if defined(__GNUC__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_FEAT_EXT_ARG)
+#define KISS_URING_NATIVE 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define KISS_URING_OP_READ      1
+#define KISS_URING_OP_WRITE     2
+#define KISS_URING_OP_CAPTURE   3
+
+// Longest wait when a stream's output would block and the epoll backend cannot watch for room
+#define KISS_URING_RETRY_NS     1000000ULL
+
+// A capture block being written in the background
+struct kiss_uring_block {
+    kiss_uring_op_t op;
+    kiss_capture_writer_t *writer;
+    uint8_t *data;
+    size_t length;
+    size_t written;
+    kiss_capture_index_entry_t entry;   // Added to the index once the block is written
+};
+typedef struct kiss_uring_block kiss_uring_block_t;
+
+static uint64_t kiss_uring_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000u + (uint64_t) t.tv_nsec;
+}
+
+// Release a stream as it is removed, the operations in flight are cancelled or left to finish
+static void kiss_uring_detach(kiss_uring_t *ring, kiss_uring_stream_t *s) {
+    s->removed = 1;
+    ring->stream_count--;
+    ring->removed_count++;
+    if (s->tx) {
+        s->tx = 0;
+        ring->senders--;
+    }
+}
+
+// Free removed streams once nothing in flight refers to them
+static void kiss_uring_reap(kiss_uring_t *ring) {
+    kiss_uring_stream_t **link = &ring->streams;
+    while (*link) {
+        kiss_uring_stream_t *s = *link;
+        if (s->removed && !s->read.busy && !s->write.busy) {
+            *link = s->next;
+            free(s);
+            ring->removed_count--;
+        } else {
+            link = &s->next;
+        }
+    }
+}
+
+// A stream hit end of file or an error, on either backend
+static void kiss_uring_stream_closed(kiss_uring_t *ring, kiss_uring_stream_t *s, int error) {
+    if (s->removed) return;
+    kiss_uring_remove(ring, s);
+    if (s->closed) s->closed(s->fd, error, s->context);
+}
+
+// The epoll backend
+
+static void kiss_uring_fallback_handler(const kiss_packet_t *packet, void *context) {
+    kiss_uring_stream_t *s = context;
+    s->handler(packet, s->context);
+}
+
+static void kiss_uring_fallback_closed(int fd, int error, void *context) {
+    kiss_uring_stream_t *s = context;
+    // The loop has already removed its own stream
+    s->fallback = 0;
+    kiss_uring_detach(s->ring, s);
+    if (s->closed) s->closed(fd, error, s->context);
+}
+
+// Initialize with the epoll backend
+int kiss_uring_init_epoll(kiss_uring_t *ring, size_t packet_size) {
+    memset(ring, 0, sizeof(*ring));
+    ring->backend = KISS_URING_EPOLL;
+    ring->fd = -1;
+    ring->packet_size = packet_size;
+    return kiss_loop_init(&ring->loop, packet_size);
+}
+
+#ifdef KISS_URING_NATIVE
+
+// The io_uring backend
+
+static int kiss_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int kiss_uring_register(int fd, unsigned opcode, void *arg, unsigned count) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+// Hand a read buffer back to the kernel
+static void kiss_uring_provide(kiss_uring_t *ring, uint16_t id) {
+    struct io_uring_buf *b = &ring->buffer_ring->bufs[ring->buffer_tail & (KISS_URING_BUFFERS - 1)];
+    b->addr = (uint64_t) (uintptr_t) (ring->buffers + (size_t) id * KISS_URING_BUFFER_SIZE);
+    b->len = KISS_URING_BUFFER_SIZE;
+    b->bid = id;
+    ring->buffer_tail++;
+    KISS_STORE_RELEASE(&ring->buffer_ring->tail, ring->buffer_tail);
+}
+
+// Map the rings shared with the kernel and register the read buffers
+static int kiss_uring_init_native(kiss_uring_t *ring, size_t packet_size) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->backend = KISS_URING_IO_URING;
+    ring->packet_size = packet_size;
+    ring->loop.epoll_fd = -1;
+
+    memset(&params, 0, sizeof(params));
+    ring->fd = kiss_uring_setup(KISS_URING_ENTRIES, &params);
+    if (ring->fd < 0) return -1;
+    // Both arrived well before provided buffer rings, but a backported kernel could lack them
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) goto fail;
+
+    // One mapping holds both queues
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->map_size = (sq_size > cq_size) ? sq_size : cq_size;
+    ring->map = mmap(0, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->map == MAP_FAILED) {
+        ring->map = 0;
+        goto fail;
+    }
+    uint8_t *m = ring->map;
+    ring->sq_head = (uint32_t *) (m + params.sq_off.head);
+    ring->sq_tail = (uint32_t *) (m + params.sq_off.tail);
+    ring->sq_mask = *(uint32_t *) (m + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (uint32_t *) (m + params.cq_off.head);
+    ring->cq_tail = (uint32_t *) (m + params.cq_off.tail);
+    ring->cq_mask = *(uint32_t *) (m + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (m + params.cq_off.cqes);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sq_submitted = ring->sq_local_tail;
+    // Entries are always used in order, so the index array never changes
+    uint32_t *array = (uint32_t *) (m + params.sq_off.array);
+    for (uint32_t i = 0; i < params.sq_entries; i++) array[i] = i;
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(0, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = 0;
+        goto fail;
+    }
+
+    // The buffer ring must be page aligned
+    ring->buffer_ring_size = KISS_URING_BUFFERS * sizeof(struct io_uring_buf);
+    ring->buffer_ring = mmap(0, ring->buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buffer_ring == MAP_FAILED) {
+        ring->buffer_ring = 0;
+        goto fail;
+    }
+    ring->buffers = malloc((size_t) KISS_URING_BUFFERS * KISS_URING_BUFFER_SIZE);
+    if (!ring->buffers) goto fail;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) ring->buffer_ring;
+    reg.ring_entries = KISS_URING_BUFFERS;
+    reg.bgid = 0;
+    if (kiss_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) goto fail;
+    for (uint16_t id = 0; id < KISS_URING_BUFFERS; id++) kiss_uring_provide(ring, id);
+    return 0;
+
+fail:
+    kiss_uring_free(ring);
+    return -1;
+}
+
+// Pass new entries to the kernel, and wait for wait_for completions or timeout_ns if it is not -1
+static int kiss_uring_enter(kiss_uring_t *ring, unsigned wait_for, int64_t timeout_ns) {
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = 0;
+    void *argp = 0;
+    size_t argsz = 0;
+
+    unsigned submit = ring->sq_local_tail - ring->sq_submitted;
+    KISS_STORE_RELEASE(ring->sq_tail, ring->sq_local_tail);
+    if (wait_for) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ns >= 0) {
+            ts.tv_sec = timeout_ns / 1000000000;
+            ts.tv_nsec = timeout_ns % 1000000000;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = (uint64_t) (uintptr_t) &ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+    if (!submit && !wait_for) return 0;
+
+    ring->stats.enters++;
+    int result = (int) syscall(__NR_io_uring_enter, ring->fd, submit, wait_for, flags, argp, argsz);
+    // Whatever the kernel took has left the queue, even if waiting failed
+    ring->sq_submitted = KISS_LOAD_ACQUIRE(ring->sq_head);
+    if (result < 0 && errno != EINTR && errno != ETIME && errno != EBUSY) return -1;
+    return 0;
+}
+
+// Return a free submission queue entry, passing queued entries to the kernel if they fill the queue
+static struct io_uring_sqe* kiss_uring_sqe(kiss_uring_t *ring, kiss_uring_op_t *op) {
+    if (ring->sq_local_tail - KISS_LOAD_ACQUIRE(ring->sq_head) >= ring->sq_entries) {
+        if (kiss_uring_enter(ring, 0, -1) < 0) return 0;
+        if (ring->sq_local_tail - KISS_LOAD_ACQUIRE(ring->sq_head) >= ring->sq_entries) return 0;
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    ring->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t) (uintptr_t) op;
+    if (op) op->busy = 1;
+    return sqe;
+}
+
+// Keep a read in flight, the kernel picks a buffer when data arrives
+static void kiss_uring_arm_read(kiss_uring_t *ring, kiss_uring_stream_t *s) {
+    struct io_uring_sqe *sqe = kiss_uring_sqe(ring, &s->read);
+    if (!sqe) {
+        ring->retry = 1;
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = s->fd;
+    sqe->off = (uint64_t) -1;
+    sqe->len = KISS_URING_BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+}
+
+// Write what the stream's queue allows now
+static void kiss_uring_write_stream(kiss_uring_t *ring, kiss_uring_stream_t *s) {
+    size_t count = kiss_tx_prepare(s->tx, s->iov, kiss_uring_now());
+    if (count == 0) return;
+    struct io_uring_sqe *sqe = kiss_uring_sqe(ring, &s->write);
+    if (!sqe) {
+        ring->retry = 1;
+        return;
+    }
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = s->fd;
+    sqe->off = (uint64_t) -1;
+    sqe->addr = (uint64_t) (uintptr_t) s->iov;
+    sqe->len = (uint32_t) count;
+    ring->writes_in_flight++;
+}
+
+// Write the rest of a capture block at its place in the file
+static int kiss_uring_write_block(kiss_uring_t *ring, kiss_uring_block_t *b) {
+    struct io_uring_sqe *sqe = kiss_uring_sqe(ring, &b->op);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = b->writer->fd;
+    sqe->addr = (uint64_t) (uintptr_t) (b->data + b->written);
+    sqe->len = (uint32_t) (b->length - b->written);
+    sqe->off = b->entry.offset + b->written;
+    return 0;
+}
+
+// Cancel an operation in flight, its completion reports -ECANCELED
+static void kiss_uring_cancel(kiss_uring_t *ring, kiss_uring_op_t *op) {
+    struct io_uring_sqe *sqe = kiss_uring_sqe(ring, 0);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t) (uintptr_t) op;
+}
+
+static int kiss_uring_read_done(kiss_uring_t *ring, kiss_uring_stream_t *s, int res, uint32_t flags) {
+    int packets = 0;
+    s->read.busy = 0;
+    // The kernel can pick a buffer even for end of file, it must always go back
+    int buffered = (flags & IORING_CQE_F_BUFFER) != 0;
+    uint16_t id = (uint16_t) (flags >> IORING_CQE_BUFFER_SHIFT);
+    if (res > 0 && buffered) {
+        const uint8_t *data = ring->buffers + (size_t) id * KISS_URING_BUFFER_SIZE;
+        size_t offset = 0;
+        ring->stats.reads++;
+        while (offset < (size_t) res && !s->removed) {
+            offset += kiss_decoder_push(&s->decoder, data + offset, (size_t) res - offset);
+            if (s->decoder.packet.complete_packet) {
+                s->handler(&s->decoder.packet, s->context);
+                packets++;
+            }
+        }
+        kiss_uring_provide(ring, id);
+        if (!s->removed) kiss_uring_arm_read(ring, s);
+        return packets;
+    }
+    if (buffered) kiss_uring_provide(ring, id);
+    if (res == -ECANCELED || s->removed) {
+        // Removed while the read was in flight
+    } else if (res == -EINTR) {
+        kiss_uring_arm_read(ring, s);
+    } else if (res == -ENOBUFS || res == -EAGAIN) {
+        // Every buffer is in use, or a nonblocking descriptor had nothing to read, try again next turn
+        ring->retry = 1;
+    } else {
+        kiss_uring_stream_closed(ring, s, (res < 0) ? -res : 0);
+    }
+    return packets;
+}
+
+static void kiss_uring_write_done(kiss_uring_t *ring, kiss_uring_stream_t *s, int res) {
+    s->write.busy = 0;
+    ring->writes_in_flight--;
+    if (s->removed || res == -ECANCELED) return;
+    if (res > 0) {
+        kiss_tx_consume(s->tx, (size_t) res);
+        s->tx->stats.writes++;
+        ring->stats.writes++;
+        kiss_uring_write_stream(ring, s);
+    } else if (res == -EINTR || res == -EAGAIN) {
+        ring->retry = 1;
+    } else {
+        kiss_uring_stream_closed(ring, s, (res < 0) ? -res : EIO);
+    }
+}
+
+static void kiss_uring_capture_done(kiss_uring_t *ring, kiss_uring_block_t *b, int res) {
+    b->op.busy = 0;
+    if (res > 0) {
+        b->written += (size_t) res;
+        // A short write carries on from where it stopped
+        if (b->written < b->length && kiss_uring_write_block(ring, b) == 0) return;
+        if (b->written == b->length) {
+            ring->stats.writes++;
+            if (kiss_capture_add_block(b->writer, &b->entry) < 0) ring->stats.errors++;
+        }
+    } else if ((res == -EINTR || res == -EAGAIN) && kiss_uring_write_block(ring, b) == 0) {
+        return;
+    }
+    if (b->written < b->length) ring->stats.errors++;
+    ring->writes_in_flight--;
+    kiss_capture_return_block(b->writer, b->data);
+    free(b);
+}
+
+// Handle every completion waiting in the queue, returns the number of packets handled
+static int kiss_uring_complete(kiss_uring_t *ring) {
+    int packets = 0;
+    uint32_t head = *ring->cq_head;
+    while (head != KISS_LOAD_ACQUIRE(ring->cq_tail)) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        kiss_uring_op_t *op = (kiss_uring_op_t *) (uintptr_t) cqe->user_data;
+        int res = cqe->res;
+        uint32_t flags = cqe->flags;
+        // Free the slot first, handlers may submit more work
+        head++;
+        KISS_STORE_RELEASE(ring->cq_head, head);
+        ring->stats.completions++;
+        if (!op) continue;      // A cancellation
+        switch (op->type) {
+        case KISS_URING_OP_READ:
+            packets += kiss_uring_read_done(ring, op->owner, res, flags);
+            break;
+        case KISS_URING_OP_WRITE:
+            kiss_uring_write_done(ring, op->owner, res);
+            break;
+        case KISS_URING_OP_CAPTURE:
+            kiss_uring_capture_done(ring, op->owner, res);
+            break;
+        }
+    }
+    return packets;
+}
+
+#endif // KISS_URING_NATIVE
+
+// Initialize with io_uring if possible and epoll otherwise
+int kiss_uring_init(kiss_uring_t *ring, size_t packet_size) {
+#ifdef KISS_URING_NATIVE
+    if (kiss_uring_init_native(ring, packet_size) == 0) return 0;
+#endif
+    return kiss_uring_init_epoll(ring, packet_size);
+}
+
+// Add a file descriptor, returns the new stream or 0 on failure
+kiss_uring_stream_t* kiss_uring_add(kiss_uring_t *ring, int fd, kiss_handler_t handler, kiss_loop_closed_t closed, void *context) {
+    int native = (ring->backend == KISS_URING_IO_URING);
+    // The packet buffer lives right after the stream
+    kiss_uring_stream_t *s = malloc(sizeof(kiss_uring_stream_t) + (native ? ring->packet_size : 0));
+    if (!s) return 0;
+    memset(s, 0, sizeof(*s));
+    s->ring = ring;
+    s->fd = fd;
+    s->handler = handler;
+    s->closed = closed;
+    s->context = context;
+    s->read.type = KISS_URING_OP_READ;
+    s->read.owner = s;
+    s->write.type = KISS_URING_OP_WRITE;
+    s->write.owner = s;
+
+    if (native) {
+        // io_uring waits for data itself, and some kernels fail reads of nonblocking descriptors with EAGAIN
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+            free(s);
+            return 0;
+        }
+        s->decoder = kiss_new_decoder((uint8_t *) (s + 1), ring->packet_size);
+    } else if (handler) {
+        s->fallback = kiss_loop_add(&ring->loop, fd, kiss_uring_fallback_handler, kiss_uring_fallback_closed, s);
+        if (!s->fallback) {
+            free(s);
+            return 0;
+        }
+    } else {
+        // Only written to, but writes must not block the loop
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            free(s);
+            return 0;
+        }
+    }
+
+    s->next = ring->streams;
+    ring->streams = s;
+    ring->stream_count++;
+#ifdef KISS_URING_NATIVE
+    if (native && handler) kiss_uring_arm_read(ring, s);
+#endif
+    return s;
+}
+
+// Stop reading and writing a stream, the file descriptor is not closed
+int kiss_uring_remove(kiss_uring_t *ring, kiss_uring_stream_t *stream) {
+    if (stream->removed) return -1;
+    kiss_uring_detach(ring, stream);
+    if (stream->fallback) {
+        kiss_loop_remove(&ring->loop, stream->fd);
+        stream->fallback = 0;
+    }
+#ifdef KISS_URING_NATIVE
+    if (stream->read.busy) kiss_uring_cancel(ring, &stream->read);
+    if (stream->write.busy) kiss_uring_cancel(ring, &stream->write);
+#endif
+    return 0;
+}
+
+// Send what the stream's queue allows now, on either backend
+static void kiss_uring_send_now(kiss_uring_t *ring, kiss_uring_stream_t *s) {
+#ifdef KISS_URING_NATIVE
+    if (ring->backend == KISS_URING_IO_URING) {
+        if (!s->write.busy && kiss_tx_length(s->tx) > 0) kiss_uring_write_stream(ring, s);
+        return;
+    }
+#endif
+    if (kiss_tx_length(s->tx) == 0) return;
+    ssize_t written = kiss_tx_flush(s->tx, s->fd, kiss_uring_now());
+    if (written > 0) ring->stats.writes++;
+    if (written < 0) kiss_uring_stream_closed(ring, s, errno);
+}
+
+// Send the frames queued on tx to a stream, and keep sending as more are queued
+int kiss_uring_send(kiss_uring_t *ring, kiss_uring_stream_t *stream, kiss_tx_t *tx) {
+    if (stream->removed) return -1;
+    if (!stream->tx && tx) ring->senders++;
+    if (stream->tx && !tx) ring->senders--;
+    stream->tx = tx;
+    if (tx) kiss_uring_send_now(ring, stream);
+    return 0;
+}
+
+// Start writing the current capture block in the background
+int kiss_uring_capture_flush(kiss_uring_t *ring, kiss_capture_writer_t *writer) {
+#ifdef KISS_URING_NATIVE
+    if (ring->backend == KISS_URING_IO_URING) {
+        kiss_uring_block_t *b = malloc(sizeof(kiss_uring_block_t));
+        if (!b) return -1;
+        memset(b, 0, sizeof(*b));
+        int result = kiss_capture_take_block(writer, &b->data, &b->length, &b->entry);
+        if (result <= 0) {
+            free(b);
+            return result;
+        }
+        b->op.type = KISS_URING_OP_CAPTURE;
+        b->op.owner = b;
+        b->writer = writer;
+        ring->writes_in_flight++;
+        if (kiss_uring_write_block(ring, b) < 0) {
+            // The queue is stuck, the block has already left the writer so count it as lost
+            kiss_uring_capture_done(ring, b, -EBUSY);
+            return -1;
+        }
+        return 0;
+    }
+#endif
+    return kiss_capture_flush(writer);
+}
+
+// Record a frame, a full block is written in the background
+int kiss_uring_capture(kiss_uring_t *ring, kiss_capture_writer_t *writer, uint64_t timestamp, const kiss_packet_t *packet) {
+    size_t length = KISS_CAPTURE_RECORD_HEADER_SIZE + packet->data_length;
+    if (ring->backend == KISS_URING_IO_URING && writer->block_records > 0 && writer->block_length + length > writer->block_capacity) {
+        if (kiss_uring_capture_flush(ring, writer) < 0) return -1;
+    }
+    return kiss_capture_write(writer, timestamp, packet);
+}
+
+// Send queued frames and work out how long the next turn may wait, in nanoseconds or -1 for ever
+static int64_t kiss_uring_send_all(kiss_uring_t *ring, int timeout_ms) {
+    int64_t timeout = (timeout_ms < 0) ? -1 : (int64_t) timeout_ms * 1000000;
+    if (!ring->senders && !ring->retry) return timeout;
+
+    int native = (ring->backend == KISS_URING_IO_URING);
+#ifdef KISS_URING_NATIVE
+    int retry = ring->retry;
+#endif
+    ring->retry = 0;
+    for (kiss_uring_stream_t *s = ring->streams; s; s = s->next) {
+        if (s->removed) continue;
+#ifdef KISS_URING_NATIVE
+        if (retry && native && s->handler && !s->read.busy) kiss_uring_arm_read(ring, s);
+#endif
+        if (!s->tx) continue;
+        kiss_uring_send_now(ring, s);
+        if (native && s->write.busy) continue;     // Its completion will wake the loop
+        if (kiss_tx_length(s->tx) == 0) continue;
+        // Paced, or the epoll backend found no room to write
+        int64_t wait = (int64_t) kiss_tx_delay(s->tx, kiss_uring_now());
+        if (wait == 0) wait = KISS_URING_RETRY_NS;
+        if (timeout < 0 || wait < timeout) timeout = wait;
+    }
+    if (ring->retry && (timeout < 0 || timeout > (int64_t) KISS_URING_RETRY_NS)) timeout = KISS_URING_RETRY_NS;
+    return timeout;
+}
+
+// Wait up to timeout_ms for activity and handle it
+int kiss_uring_run_once(kiss_uring_t *ring, int timeout_ms) {
+    int64_t timeout = kiss_uring_send_all(ring, timeout_ms);
+    int packets;
+
+#ifdef KISS_URING_NATIVE
+    if (ring->backend == KISS_URING_IO_URING) {
+        // Anything already completed is handled without waiting
+        int wait = (*ring->cq_head == KISS_LOAD_ACQUIRE(ring->cq_tail)) && timeout != 0;
+        if (kiss_uring_enter(ring, wait ? 1 : 0, timeout) < 0) return -1;
+        packets = kiss_uring_complete(ring);
+        if (ring->removed_count) kiss_uring_reap(ring);
+        return packets;
+    }
+#endif
+
+    // epoll_wait counts in milliseconds, round up so paced output is not early
+    int wait_ms = (timeout < 0) ? -1 : (int) ((timeout + 999999) / 1000000);
+    packets = kiss_loop_run_once(&ring->loop, wait_ms);
+    if (ring->removed_count) kiss_uring_reap(ring);
+    return packets;
+}
+
+// Run until kiss_uring_stop is called or no streams are left
+int kiss_uring_run(kiss_uring_t *ring) {
+    ring->running = 1;
+    while (ring->running && ring->stream_count > 0) {
+        if (kiss_uring_run_once(ring, -1) < 0) return -1;
+    }
+    return 0;
+}
+
+// Make kiss_uring_run return after the current turn
+void kiss_uring_stop(kiss_uring_t *ring) {
+    ring->running = 0;
+}
+
+// Wait for every write in flight
+int kiss_uring_drain(kiss_uring_t *ring) {
+    size_t errors = ring->stats.errors;
+    while (ring->writes_in_flight > 0) {
+        if (kiss_uring_run_once(ring, -1) < 0) return -1;
+    }
+    return (ring->stats.errors == errors) ? 0 : -1;
+}
+
+// Release all streams and memory, file descriptors are not closed
+void kiss_uring_free(kiss_uring_t *ring) {
+#ifdef KISS_URING_NATIVE
+    if (ring->backend == KISS_URING_IO_URING && ring->fd >= 0) {
+        // The kernel must be done with every buffer before it is freed
+        if (ring->sqes && ring->buffers) {
+            kiss_uring_drain(ring);
+            for (kiss_uring_stream_t *s = ring->streams; s; s = s->next) {
+                if (!s->removed) kiss_uring_remove(ring, s);
+            }
+            while (ring->removed_count) {
+                kiss_uring_reap(ring);
+                if (!ring->removed_count || kiss_uring_enter(ring, 1, -1) < 0) break;
+                kiss_uring_complete(ring);
+            }
+        }
+        close(ring->fd);
+        ring->fd = -1;
+        if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+        if (ring->map) munmap(ring->map, ring->map_size);
+        if (ring->buffer_ring) munmap(ring->buffer_ring, ring->buffer_ring_size);
+        ring->sqes = 0;
+        ring->map = 0;
+        ring->buffer_ring = 0;
+        free(ring->buffers);
+        ring->buffers = 0;
+    }
+#endif
+    kiss_uring_stream_t *s = ring->streams;
+    while (s) {
+        kiss_uring_stream_t *next = s->next;
+        free(s);
+        s = next;
+    }
+    ring->streams = 0;
+    ring->stream_count = 0;
+    ring->removed_count = 0;
+    ring->senders = 0;
+    if (ring->backend == KISS_URING_EPOLL) kiss_loop_free(&ring->loop);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __linux__
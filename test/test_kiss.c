@@ -21,7 +21,25 @@ SOFTWARE.
 */
 
 #include <kiss.h>
+#include <kiss_ring.h>
+#include <kiss_stats.h>
+#include <kiss_ax25.h>
+#include <kiss_crc.h>
+#include <kiss_dedup.h>
+#include <kiss_demux.h>
+#include <kiss_queue.h>
+#include <kiss_pool.h>
+#include <kiss_pipeline.h>
+#include <kiss_parallel.h>
+#include <kiss_capture.h>
+#include <kiss_loop.h>
+#include <kiss_server.h>
+#include <kiss_shm.h>
+#include <kiss_tx.h>
+#include <kiss_uring.h>
 #include <unity.h>
+#include <stdlib.h>
+#include <string.h>
 
 static uint8_t DECODED_DATA[] = {'T','E','S','T',0xC0,0xDB,0xDB,0xC0};
 static size_t DECODED_DATA_LEN = sizeof(DECODED_DATA);
@@ -49,6 +67,51 @@ void test_decode_data() {
   TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, buffer, bytes_written, "Decoded data is wrong.");
 }
 
+void test_find_special() {
+  uint8_t buffer[100];
+  for (size_t i = 0; i < sizeof(buffer); i++) buffer[i] = 'A' + (i % 26);
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(buffer), kiss_find_special(buffer, sizeof(buffer)), "Found a special byte in clean data.");
+  for (size_t i = 0; i < sizeof(buffer); i++) {
+    uint8_t saved = buffer[i];
+    buffer[i] = (i % 2) ? KISS_FRAME_END : KISS_FRAME_ESCAPE;
+    TEST_ASSERT_EQUAL_MESSAGE(i, kiss_find_special(buffer, sizeof(buffer)), "Special byte found at the wrong position.");
+    buffer[i] = saved;
+  }
+}
+
+// Byte by byte reference for the scanners
+static size_t find_special_reference(const uint8_t *buffer, size_t buffer_size) {
+  size_t i = 0;
+  while (i < buffer_size && buffer[i] != KISS_FRAME_END && buffer[i] != KISS_FRAME_ESCAPE) i++;
+  return i;
+}
+
+void test_scanners() {
+  const char *names[] = {"swar", "sse2", "avx2", "neon"};
+  // Bytes close to FEND and FESC, to catch false matches
+  const uint8_t near[] = {0xC1, 0xBF, 0xDA, 0xDC, 0x40, 0x5B, 0x00, 0xFF};
+  uint8_t buffer[100];
+  TEST_ASSERT_NOT_NULL_MESSAGE(kiss_scan_get("swar"), "The portable scanner is missing.");
+  TEST_ASSERT_NULL_MESSAGE(kiss_scan_get("none"), "Unknown scanner was found.");
+  for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+    kiss_scan_fn_t scan = kiss_scan_get(names[n]);
+    if (!scan) continue;
+    // Every start alignment and length, with no match, a match anywhere, and one at the last byte
+    for (size_t start = 0; start < 16; start++) {
+      for (size_t length = 0; start + length <= sizeof(buffer); length++) {
+        uint8_t *b = buffer + start;
+        for (size_t i = 0; i < sizeof(buffer); i++) buffer[i] = near[(i * 3) % sizeof(near)];
+        TEST_ASSERT_EQUAL_MESSAGE(find_special_reference(b, length), scan(b, length), names[n]);
+        for (size_t i = 0; i < length; i++) {
+          b[i] = (i % 2) ? KISS_FRAME_END : KISS_FRAME_ESCAPE;
+          TEST_ASSERT_EQUAL_MESSAGE(find_special_reference(b, length), scan(b, length), names[n]);
+          if (i + 1 < length) b[i] = 'x';
+        }
+      }
+    }
+  }
+}
+
 void test_encode_command() {
   uint8_t b;
   b = kiss_encode_command(0,0);
@@ -85,6 +148,69 @@ void test_encode_packet() {
   TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(ENCODED_PACKET, buffer, bytes_written, "Encoded packet is wrong.");
 }
 
+void test_encoded_length() {
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, kiss_encoded_length(&DECODED_PACKET), "Encoded length is wrong.");
+  uint8_t buffer[256];
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_encode_packet(DECODED_PACKET, buffer, ENCODED_PACKET_LEN - 1), "Packet should not fit.");
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, kiss_encode_packet(DECODED_PACKET, buffer, ENCODED_PACKET_LEN), "Packet should fit exactly.");
+}
+
+void test_encode_packet_iov() {
+  uint8_t header[3];
+  kiss_iovec_t iov[16];
+  size_t count = kiss_encode_packet_iov(&DECODED_PACKET, header, iov, 16);
+  TEST_ASSERT_EQUAL_MESSAGE(7, count, "Wrong number of iovec entries.");
+  TEST_ASSERT_EQUAL_PTR_MESSAGE(DECODED_DATA, iov[1].iov_base, "Clean data should not be copied.");
+  uint8_t buffer[256];
+  size_t len = 0;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(buffer + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, len, "Encoded packet is the wrong length.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(ENCODED_PACKET, buffer, len, "Encoded packet is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_encode_packet_iov(&DECODED_PACKET, header, iov, 6), "Too few iovec entries should fail.");
+}
+
+void test_escaped_command() {
+  // Data frames on port 12 have a command byte of FEND, every encoder escapes it and every decoder undoes that
+  kiss_packet_t port12 = DECODED_PACKET;
+  port12.port = 12;
+  uint8_t buffer[256];
+  size_t len = kiss_encode_packet(port12, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN + 1, len, "Encoded packet is the wrong length.");
+  TEST_ASSERT_EQUAL_MESSAGE(len, kiss_encoded_length(&port12), "Encoded length is wrong.");
+  const uint8_t start[] = {KISS_FRAME_END, KISS_FRAME_ESCAPE, KISS_ESCAPE_FEND};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(start, buffer, sizeof(start), "Command byte was not escaped.");
+
+  uint8_t header[3];
+  kiss_iovec_t iov[16];
+  uint8_t gathered[256];
+  size_t count = kiss_encode_packet_iov(&port12, header, iov, 16);
+  size_t gathered_len = 0;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(gathered + gathered_len, iov[i].iov_base, iov[i].iov_len);
+    gathered_len += iov[i].iov_len;
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(len, gathered_len, "Gathered packet is the wrong length.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(buffer, gathered, len, "Gathered packet is wrong.");
+
+  uint8_t data[256];
+  kiss_packet_t p = kiss_new_packet(data, sizeof(data));
+  TEST_ASSERT_EQUAL_MESSAGE(len, kiss_decode_packet(&p, buffer, len), "Wrong number of bytes consumed.");
+  TEST_ASSERT_EQUAL_MESSAGE(12, p.port, "Port is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(KISS_DATA_FRAME, p.command, "Command is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, p.data, DECODED_DATA_LEN, "Data is wrong.");
+
+  kiss_frame_t f;
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_decode_packets(buffer, len, &f, 1, 0), "Frame was not found.");
+  TEST_ASSERT_EQUAL_MESSAGE(12, f.port, "Port is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, f.data_length, "Data length is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, kiss_frame_data(buffer, &f), DECODED_DATA_LEN, "Data is wrong.");
+  // The data was decoded in place, asking again must not decode it twice
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, kiss_frame_data(buffer, &f), DECODED_DATA_LEN, "Data was decoded twice.");
+}
+
 void test_decode_packet() {
   uint8_t buffer[256];
   kiss_packet_t p = kiss_new_packet(buffer, sizeof(buffer));
@@ -119,15 +245,989 @@ void test_decode_with_second_packet() {
   TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, p.data, p.data_length, "Data is wrong.");
 }
 
+void test_decode_packets() {
+  uint8_t buffer[256];
+  size_t len = 0;
+  // Two complete packets followed by a partial one
+  memcpy(buffer + len, ENCODED_PACKET, ENCODED_PACKET_LEN);
+  len += ENCODED_PACKET_LEN;
+  memcpy(buffer + len, ENCODED_PACKET_WITH_SECOND_PACKET, ENCODED_PACKET_WITH_SECOND_PACKET_LEN);
+  len += ENCODED_PACKET_WITH_SECOND_PACKET_LEN;
+
+  kiss_frame_t frames[4];
+  size_t resume = 0;
+  size_t count = kiss_decode_packets(buffer, len, frames, 4, &resume);
+  TEST_ASSERT_EQUAL_MESSAGE(3, count, "Wrong number of frames found.");
+  TEST_ASSERT_EQUAL_MESSAGE(len - 2, resume, "Resume point is wrong.");
+  for (size_t i = 0; i < 2; i++) {
+    uint8_t data[256];
+    TEST_ASSERT_EQUAL_MESSAGE(1, frames[i].complete_frame, "Frame should be complete.");
+    TEST_ASSERT_EQUAL_MESSAGE(KISS_DATA_FRAME, frames[i].command, "Command is wrong.");
+    TEST_ASSERT_EQUAL_MESSAGE(ENCODED_DATA_LEN, frames[i].encoded_length, "Encoded length is wrong.");
+    TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, frames[i].data_length, "Data length is wrong.");
+    size_t data_length = kiss_decode_data(buffer + frames[i].offset, frames[i].encoded_length, data, sizeof(data));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, data, data_length, "Data is wrong.");
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, frames[2].complete_frame, "Last frame should be partial.");
+  TEST_ASSERT_EQUAL_MESSAGE(KISS_PERSISTENCE, frames[2].command, "Partial frame command is wrong.");
+
+  // Out of room for descriptors, resume at the start of the second frame
+  count = kiss_decode_packets(buffer, len, frames, 1, &resume);
+  TEST_ASSERT_EQUAL_MESSAGE(1, count, "Wrong number of frames found with one descriptor.");
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN + 2, resume, "Resume point is wrong with one descriptor.");
+}
+
+void test_decode_data_in_place() {
+  uint8_t buffer[256];
+  memcpy(buffer, ENCODED_DATA, ENCODED_DATA_LEN);
+  size_t bytes_written = kiss_decode_data_in_place(buffer, ENCODED_DATA_LEN);
+  TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, bytes_written, "Decoded data is the wrong length.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, buffer, bytes_written, "Decoded data is wrong.");
+}
+
+void test_decode_packet_in_place() {
+  uint8_t buffer[256];
+  uint8_t clean[] = {0xC0,0x10,'T','E','S','T',0xC0};
+  kiss_packet_t p = kiss_new_packet(0, 0);
+
+  // A packet without escapes is a view into the buffer
+  memcpy(buffer, clean, sizeof(clean));
+  size_t bytes_consumed = kiss_decode_packet_in_place(&p, buffer, sizeof(clean));
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(clean), bytes_consumed, "Wrong number of bytes consumed from clean packet.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, p.port, "Port is wrong.");
+  TEST_ASSERT_EQUAL_PTR_MESSAGE(buffer + 2, p.data, "Clean packet was not a view into the buffer.");
+  TEST_ASSERT_EQUAL_MESSAGE(4, p.data_length, "Clean packet data length is wrong.");
+
+  // A packet with escapes is decoded in place
+  memcpy(buffer, ENCODED_PACKET_WITH_PADDING, ENCODED_PACKET_WITH_PADDING_LEN);
+  bytes_consumed = kiss_decode_packet_in_place(&p, buffer, ENCODED_PACKET_WITH_PADDING_LEN);
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_WITH_PADDING_LEN, bytes_consumed, "Wrong number of bytes consumed.");
+  TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, p.data_length, "Data length is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, p.data, p.data_length, "Data is wrong.");
+}
+
+void test_decoder_byte_at_a_time() {
+  uint8_t buffer[256];
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  size_t packets = 0;
+  for (size_t i = 0; i < ENCODED_PACKET_WITH_SECOND_PACKET_LEN; i++) {
+    if (kiss_decoder_push_byte(&d, ENCODED_PACKET_WITH_SECOND_PACKET[i])) {
+      packets++;
+      TEST_ASSERT_EQUAL_MESSAGE(DECODED_PACKET.port, d.packet.port, "Port is wrong.");
+      TEST_ASSERT_EQUAL_MESSAGE(DECODED_PACKET.command, d.packet.command, "Command is wrong.");
+      TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, d.packet.data_length, "Data length is wrong.");
+      TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, d.packet.data, d.packet.data_length, "Data is wrong.");
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(1, packets, "Wrong number of packets decoded.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, d.packet.complete_packet, "Second packet should be incomplete.");
+  TEST_ASSERT_EQUAL_MESSAGE(KISS_PERSISTENCE, d.packet.command, "Second packet command is wrong.");
+}
+
+void test_decoder_split_chunks() {
+  uint8_t buffer[256];
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  // Split in the middle of an escape sequence
+  size_t consumed = kiss_decoder_push(&d, ENCODED_PACKET, 7);
+  TEST_ASSERT_EQUAL_MESSAGE(7, consumed, "Wrong number of bytes consumed from first chunk.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, d.packet.complete_packet, "Packet should be incomplete.");
+  consumed = kiss_decoder_push(&d, ENCODED_PACKET + 7, ENCODED_PACKET_LEN - 7);
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN - 7, consumed, "Wrong number of bytes consumed from second chunk.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, d.packet.complete_packet, "Packet should be complete.");
+  TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, d.packet.data_length, "Data length is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, d.packet.data, d.packet.data_length, "Data is wrong.");
+}
+
+void test_decoder_stats() {
+  // Noise, a frame with an invalid escape, an empty frame on port 1 and a frame too big for the buffer
+  uint8_t encoded[] = {'x', 'y', 0xC0, 0x00, 'a', 0xDB, 'q', 'b', 0xC0, 0x10, 0xC0, 0x00, '1', '2', '3', '4', '5', '6', 0xC0};
+  uint8_t buffer[4];
+  kiss_stats_t stats;
+  kiss_stats_init(&stats, 1);
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  kiss_decoder_set_stats(&d, &stats);
+  size_t offset = 0;
+  while (offset < sizeof(encoded)) {
+    offset += kiss_decoder_push(&d, encoded + offset, sizeof(encoded) - offset);
+  }
+  kiss_stats_t snapshot;
+  kiss_stats_snapshot(&stats, &snapshot);
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(encoded), snapshot.bytes_in, "Bytes in is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(7, snapshot.bytes_out, "Bytes out is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, snapshot.dropped_bytes, "Dropped bytes is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(3, snapshot.frames, "Frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.empty_frames, "Empty frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.escapes, "Escape count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.invalid_escapes, "Invalid escape count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.truncated, "Truncated frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, snapshot.truncated_bytes, "Truncated byte count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, snapshot.ports[0].frames, "Port 0 frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(14, snapshot.ports[0].bytes_in, "Port 0 bytes in is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(7, snapshot.ports[0].bytes_out, "Port 0 bytes out is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.ports[0].escapes, "Port 0 escape count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.ports[0].truncated, "Port 0 truncated count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, snapshot.ports[0].empty_frames, "Port 0 empty frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.ports[1].frames, "Port 1 frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, snapshot.ports[1].bytes_in, "Port 1 bytes in is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.ports[1].empty_frames, "Port 1 empty frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, snapshot.size_histogram[kiss_stats_bucket(3)], "Size histogram is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(3, snapshot.latency_histogram[0], "Latency histogram is wrong.");
+}
+
+// Collects the fragments of a frame
+struct fragments {
+  uint8_t data[32];
+  size_t length;
+  size_t calls;
+  uint8_t ended;
+  size_t total;
+};
+
+static void collect_fragment(const kiss_fragment_t *fragment, void *context) {
+  struct fragments *f = (struct fragments *) context;
+  TEST_ASSERT_EQUAL_MESSAGE(f->length, fragment->offset, "Fragment offset is wrong.");
+  memcpy(f->data + f->length, fragment->data, fragment->length);
+  f->length += fragment->length;
+  f->calls++;
+  if (fragment->end) {
+    f->ended = 1;
+    f->total = fragment->total;
+  }
+}
+
+void test_decoder_fragments() {
+  // A frame too big for the buffer, then one that fits
+  uint8_t encoded[] = {0xC0, 0x00, '0', '1', '2', 0xDB, 0xDC, '4', '5', '6', '7', '8', 0xC0, 0x00, 'a', 'b', 0xC0};
+  uint8_t expected[] = {'0', '1', '2', 0xC0, '4', '5', '6', '7', '8'};
+  uint8_t buffer[4];
+  struct fragments f;
+  memset(&f, 0, sizeof(f));
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  kiss_decoder_set_fragments(&d, collect_fragment, &f);
+  size_t offset = kiss_decoder_push(&d, encoded, sizeof(encoded));
+  TEST_ASSERT_EQUAL_MESSAGE(1, f.ended, "Big frame did not end.");
+  TEST_ASSERT_EQUAL_MESSAGE(3, f.calls, "Fragment count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(expected), f.total, "Total length is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected, f.data, sizeof(expected), "Fragment data is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(encoded), offset, "Small frame was not reached.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, d.packet.complete_packet, "Small frame was not returned.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, d.packet.data_length, "Small frame length is wrong.");
+}
+
+// Build an AX.25 UI frame header: destination, source and one digipeater
+static size_t ax25_frame(uint8_t *frame, const char *source) {
+  const char *calls[3] = {"APRS  ", source, "WIDE1 "};
+  const uint8_t ssids[3] = {0, 7, 1};
+  for (int a = 0; a < 3; a++) {
+    for (int i = 0; i < 6; i++) frame[a * 7 + i] = (uint8_t) (calls[a][i] << 1);
+    frame[a * 7 + 6] = (uint8_t) ((ssids[a] << 1) | (a == 2));
+  }
+  frame[21] = 0x03;
+  frame[22] = 0xF0;
+  // A payload long enough that copying it would matter
+  memset(frame + 23, 'x', 200);
+  return 223;
+}
+
+void test_ax25_filter() {
+  kiss_ax25_filter_t filter;
+  kiss_ax25_filter_init(&filter, KISS_AX25_ACCEPT);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_ax25_filter_add(&filter, "n0call-*", KISS_AX25_SOURCE), "Could not add callsign.");
+  TEST_ASSERT_EQUAL_MESSAGE(-1, kiss_ax25_filter_add(&filter, "TOOLONG1", KISS_AX25_ANY), "Bad callsign was accepted.");
+
+  uint8_t data[256], encoded[1024];
+  size_t length = 0;
+  const char *sources[3] = {"K1ABC ", "N0CALL", "W1AW  "};
+  for (int i = 0; i < 3; i++) {
+    kiss_packet_t p = kiss_new_packet(data, sizeof(data));
+    p.data_length = ax25_frame(data, sources[i]);
+    length += kiss_encode_packet(p, encoded + length, sizeof(encoded) - length);
+  }
+
+  uint8_t buffer[256];
+  kiss_stats_t stats;
+  kiss_stats_init(&stats, 0);
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  kiss_decoder_set_ax25_filter(&d, &filter);
+  kiss_decoder_set_stats(&d, &stats);
+  size_t packets = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (kiss_decoder_push_byte(&d, encoded[i])) {
+      packets++;
+      TEST_ASSERT_EQUAL_MESSAGE(223, d.packet.data_length, "Accepted frame is incomplete.");
+      TEST_ASSERT_EQUAL_HEX8_MESSAGE('N' << 1, d.packet.data[7], "Wrong frame was accepted.");
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(1, packets, "Wrong number of frames accepted.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, stats.filtered_frames, "Rejected frames were not counted.");
+}
+
+void test_dedup() {
+  uint8_t frame[256];
+  uint8_t repeated[256];
+  kiss_dedup_entry_t entries[64];
+  kiss_dedup_t path, exact;
+  TEST_ASSERT_EQUAL_MESSAGE(-1, kiss_dedup_init(&path, entries, 12, 30, 1), "Table size was not checked.");
+  kiss_dedup_init(&path, entries, 64, 30, 1);
+
+  // The same frame after a digipeater has set its has-been-repeated bit
+  size_t len = ax25_frame(frame, "N0CALL");
+  memcpy(repeated, frame, len);
+  repeated[20] |= 0x80;
+  kiss_packet_t original = kiss_new_packet(frame, len);
+  original.data_length = len;
+  kiss_packet_t copy = kiss_new_packet(repeated, len);
+  copy.data_length = len;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_dedup_check(&path, &original, 0), "New frame was a duplicate.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_dedup_check(&path, &copy, 10), "Repeated frame was not a duplicate.");
+  // The window is not a multiple of the bucket count, and must not shrink to one
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_dedup_check(&path, &copy, 20), "Repeat inside the window was not a duplicate.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_dedup_check(&path, &copy, 40), "Frame did not expire.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, path.unique, "Unique count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, path.duplicates, "Duplicate count is wrong.");
+
+  // Without ignoring the path the copy is a different frame
+  kiss_dedup_init(&exact, entries, 64, 30, 0);
+  kiss_dedup_check(&exact, &original, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_dedup_check(&exact, &copy, 1), "Path was ignored.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_dedup_check(&exact, &original, 2), "Exact copy was not a duplicate.");
+
+  // Nor may a window shorter than the bucket count grow to one
+  kiss_dedup_init(&exact, entries, 64, 5, 0);
+  kiss_dedup_check(&exact, &original, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_dedup_check(&exact, &original, 4), "Repeat inside a short window was not a duplicate.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_dedup_check(&exact, &original, 12), "Frame outlived a short window.");
+}
+
+void test_crc() {
+  // Standard check values, and the slice-by-8 path must agree with the byte at a time one
+  const uint8_t check[] = "123456789";
+  TEST_ASSERT_EQUAL_HEX16_MESSAGE(0xBB3D, kiss_crc16(0, check, 9), "CRC-16 check value is wrong.");
+  uint16_t crc = 0;
+  for (int i = 0; i < 9; i++) crc = kiss_crc16(crc, check + i, 1);
+  TEST_ASSERT_EQUAL_HEX16_MESSAGE(0xBB3D, crc, "Incremental CRC-16 is wrong.");
+
+  // A SMACK frame decodes with its CRC checked and removed
+  uint8_t data[] = {'T', 'E', 0xC0, 'S', 0xDB, 'T'};
+  uint8_t encoded[32];
+  uint8_t buffer[16];
+  kiss_packet_t packet = kiss_new_packet(data, sizeof(data));
+  packet.data_length = sizeof(data);
+  packet.port = 3;
+  kiss_crc_link_t tx = kiss_new_crc_link(KISS_CRC_SMACK);
+  kiss_crc_link_t rx = kiss_new_crc_link(KISS_CRC_AUTO);
+  size_t len = kiss_encode_packet_crc(&tx, &packet, encoded, sizeof(encoded));
+  TEST_ASSERT_EQUAL_HEX8_MESSAGE(0xB0, encoded[1], "SMACK command byte is wrong.");
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  kiss_decoder_set_crc(&d, &rx);
+  kiss_decoder_push(&d, encoded, len);
+  TEST_ASSERT_EQUAL_MESSAGE(1, d.packet.complete_packet, "SMACK frame was not decoded.");
+  TEST_ASSERT_EQUAL_MESSAGE(3, d.packet.port, "SMACK port is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(data), d.packet.data_length, "SMACK CRC was not removed.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(data, d.packet.data, sizeof(data), "SMACK data is wrong.");
+
+  // A damaged frame is dropped and counted
+  encoded[3] ^= 0x01;
+  kiss_decoder_push(&d, encoded, len);
+  TEST_ASSERT_EQUAL_MESSAGE(0, d.packet.complete_packet, "Damaged SMACK frame was not dropped.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, rx.bad, "CRC error count is wrong.");
+
+  // A plain data frame turns SMACK off for that port only
+  len = kiss_encode_packet(packet, encoded, sizeof(encoded));
+  kiss_decoder_push(&d, encoded, len);
+  TEST_ASSERT_EQUAL_MESSAGE(1, d.packet.complete_packet, "Plain frame was not decoded.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, rx.smack[3], "Port 3 did not drop back to plain KISS.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, rx.smack[0], "Port 0 left SMACK mode.");
+  len = kiss_encode_packet_crc(&rx, &packet, encoded, sizeof(encoded));
+  TEST_ASSERT_EQUAL_HEX8_MESSAGE(0x30, encoded[1], "Port 3 still sends SMACK frames.");
+
+  // FlexNet frames round trip too
+  packet.port = 0;
+  tx = kiss_new_crc_link(KISS_CRC_FLEX);
+  len = kiss_encode_packet_crc(&tx, &packet, encoded, sizeof(encoded));
+  TEST_ASSERT_EQUAL_HEX8_MESSAGE(0x20, encoded[1], "FlexNet command byte is wrong.");
+  kiss_decoder_set_crc(&d, &tx);
+  kiss_decoder_push(&d, encoded, len);
+  TEST_ASSERT_EQUAL_MESSAGE(1, d.packet.complete_packet, "FlexNet frame was not decoded.");
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(data), d.packet.data_length, "FlexNet CRC was not removed.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, tx.good, "FlexNet good frame count is wrong.");
+}
+
+// Concatenate the buffers returned by kiss_tx_prepare
+static size_t tx_gather(kiss_tx_t *tx, uint8_t *out, uint64_t now) {
+  kiss_iovec_t iov[KISS_TX_MAX_IOV];
+  size_t count = kiss_tx_prepare(tx, iov, now);
+  size_t len = 0;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(out + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  return len;
+}
+
+void test_tx() {
+  uint8_t buffer[256];
+  uint8_t out[256];
+  uint8_t data[] = {'A', 0xC0, 'B'};
+  uint8_t value = 20;
+  kiss_tx_t tx;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_tx_init(&tx, buffer, sizeof(buffer)), "Transmit queue init failed.");
+
+  // Parameters and SET_HARDWARE go ahead of data, and only the latest TX delay is sent
+  kiss_packet_t frame = kiss_new_packet(data, sizeof(data));
+  frame.data_length = sizeof(data);
+  kiss_packet_t parameter = kiss_new_packet(&value, 1);
+  parameter.data_length = 1;
+  parameter.command = KISS_TX_DELAY;
+  kiss_tx_queue(&tx, &frame);
+  kiss_tx_queue(&tx, &parameter);
+  value = 30;
+  kiss_tx_queue(&tx, &parameter);
+  kiss_packet_t hardware = kiss_new_packet(&value, 1);
+  hardware.data_length = 1;
+  hardware.command = KISS_SET_HARDWARE;
+  kiss_tx_queue(&tx, &hardware);
+  uint8_t expected[] = {0xC0, 0x01, 30, 0xC0, 0xC0, 0x06, 30, 0xC0, 0xC0, 0x00, 'A', 0xDB, 0xDC, 'B', 0xC0};
+  size_t len = tx_gather(&tx, out, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(expected), len, "Batched length is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected, out, sizeof(expected), "Batched frames are wrong.");
+  kiss_tx_consume(&tx, len);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_tx_length(&tx), "Queue did not empty.");
+
+  // The TNC already has this value
+  kiss_tx_queue(&tx, &parameter);
+  TEST_ASSERT_EQUAL_MESSAGE(0, tx_gather(&tx, out, 0), "Known parameter was sent again.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, tx.stats.deduplicated, "Deduplicated count is wrong.");
+
+  // Nothing is put in the middle of a partly written frame
+  kiss_tx_queue(&tx, &frame);
+  tx_gather(&tx, out, 0);
+  kiss_tx_consume(&tx, 3);
+  kiss_tx_queue(&tx, &hardware);
+  len = tx_gather(&tx, out, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(8, len, "Length after a partial write is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected + 11, out, 4, "Partly written frame was not finished first.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected + 4, out + 4, 4, "SET_HARDWARE frame is in the wrong place.");
+  kiss_tx_consume(&tx, len);
+
+  // 8000 bits per second is one byte per millisecond, with room for 10 bytes in the TNC
+  kiss_tx_set_rate(&tx, 8000, 10, 0);
+  for (int i = 0; i < 2; i++) kiss_tx_queue(&tx, &frame);
+  TEST_ASSERT_EQUAL_MESSAGE(10, tx_gather(&tx, out, 0), "Burst was not limited.");
+  kiss_tx_consume(&tx, 10);
+  TEST_ASSERT_EQUAL_MESSAGE(4000000, kiss_tx_delay(&tx, 0), "Delay is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(3, tx_gather(&tx, out, 3000000), "Output was not paced.");
+}
+
+void test_ring_decode() {
+  uint8_t ring_buffer[16];
+  uint8_t buffer[256];
+  kiss_ring_t ring = kiss_new_ring(ring_buffer, sizeof(ring_buffer));
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  size_t written = 0;
+  size_t packets = 0;
+  // Packets are longer than the ring, so they wrap around it
+  for (int round = 0; round < 3; round++) {
+    written = 0;
+    while (written < ENCODED_PACKET_LEN) {
+      written += kiss_ring_write(&ring, ENCODED_PACKET + written, ENCODED_PACKET_LEN - written);
+      while (kiss_ring_length(&ring) > 0) {
+        kiss_ring_decode(&ring, &d);
+        if (d.packet.complete_packet) {
+          packets++;
+          TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, d.packet.data_length, "Data length is wrong.");
+          TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, d.packet.data, d.packet.data_length, "Data is wrong.");
+        }
+      }
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(3, packets, "Wrong number of packets decoded.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, ring.dropped, "No bytes should be dropped.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_new_ring(ring_buffer, 15).mask, "Ring size must be a power of two.");
+}
+
+static void count_handler(const kiss_packet_t *packet, void *context) {
+  (void) packet;
+  (*(size_t *) context)++;
+}
+
+void test_demux() {
+  uint8_t buffer[256];
+  uint8_t queue_buffer[64];
+  size_t data_frames = 0;
+  kiss_ring_t queue = kiss_new_ring(queue_buffer, sizeof(queue_buffer));
+  kiss_demux_t demux;
+  kiss_demux_init(&demux);
+  kiss_demux_register(&demux, 0, KISS_DATA_FRAME, count_handler, &data_frames);
+  kiss_demux_register(&demux, 1, KISS_DATA_FRAME, kiss_demux_queue_handler, &queue);
+
+  // Port 0 data, port 1 data, port 0 TX delay, port 2 data
+  uint8_t stream[] = {0xC0,0x00,'A',0xC0,0x10,'B',0xDB,0xDC,0xC0,0x01,0x20,0xC0,0x20,'C',0xC0};
+  kiss_decoder_t d = kiss_new_decoder(buffer, sizeof(buffer));
+  kiss_demux_attach(&demux, &d);
+  size_t consumed = kiss_demux_push(&demux, &d, stream, sizeof(stream));
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(stream), consumed, "Wrong number of bytes consumed.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, data_frames, "Port 0 handler called the wrong number of times.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, demux.stats[1].frames, "Port 1 frame count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, demux.stats[1].bytes, "Port 1 byte count is wrong.");
+
+  kiss_packet_t p = kiss_new_packet(buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_ring_get_packet(&queue, &p), "Port 1 packet was not queued.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, p.port, "Queued packet port is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, p.data_length, "Queued packet length is wrong.");
+  TEST_ASSERT_EQUAL_HEX8_MESSAGE(0xC0, p.data[1], "Queued packet data is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_ring_get_packet(&queue, &p), "Only one packet should be queued.");
+
+  // The same stream through the batch path counts the unwanted frames
+  size_t resume = 0;
+  size_t dispatched = kiss_demux_decode(&demux, stream, sizeof(stream), &resume);
+  TEST_ASSERT_EQUAL_MESSAGE(2, dispatched, "Wrong number of frames dispatched.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, demux.stats[0].unhandled, "Port 0 unhandled count is wrong.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, demux.stats[2].unhandled, "Port 2 unhandled count is wrong.");
+}
+
+void test_queues() {
+  kiss_packet_t slots[4];
+  kiss_mpmc_cell_t cells[4];
+  uint8_t data[4 * 16];
+  kiss_spsc_t spsc;
+  kiss_mpmc_t mpmc;
+  TEST_ASSERT_EQUAL_MESSAGE(-1, kiss_spsc_init(&spsc, slots, 3, data, 16), "Queue size must be a power of two.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_spsc_init(&spsc, slots, 4, data, 16), "SPSC queue init failed.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_mpmc_init(&mpmc, cells, 4, data, 16), "MPMC queue init failed.");
+
+  kiss_packet_t source = kiss_new_packet(DECODED_DATA, DECODED_DATA_LEN);
+  source.data_length = DECODED_DATA_LEN;
+  for (int i = 0; i < 4; i++) {
+    kiss_packet_t *p = kiss_spsc_begin_push(&spsc);
+    TEST_ASSERT_NOT_NULL_MESSAGE(p, "SPSC queue should have room.");
+    source.port = i;
+    kiss_copy_packet(p, &source);
+    kiss_spsc_end_push(&spsc);
+  }
+  TEST_ASSERT_NULL_MESSAGE(kiss_spsc_begin_push(&spsc), "SPSC queue should be full.");
+  for (int i = 0; i < 4; i++) {
+    kiss_packet_t *p = kiss_spsc_begin_pop(&spsc);
+    TEST_ASSERT_NOT_NULL_MESSAGE(p, "SPSC queue should not be empty.");
+    TEST_ASSERT_EQUAL_MESSAGE(i, p->port, "SPSC queue order is wrong.");
+    kiss_spsc_end_pop(&spsc);
+  }
+  TEST_ASSERT_NULL_MESSAGE(kiss_spsc_begin_pop(&spsc), "SPSC queue should be empty.");
+
+  // Wrap around the MPMC queue a few times
+  for (int i = 0; i < 10; i++) {
+    kiss_mpmc_cell_t *cell = kiss_mpmc_begin_push(&mpmc);
+    TEST_ASSERT_NOT_NULL_MESSAGE(cell, "MPMC queue should have room.");
+    source.port = i;
+    kiss_copy_packet(&cell->packet, &source);
+    kiss_mpmc_end_push(&mpmc, cell);
+    cell = kiss_mpmc_begin_pop(&mpmc);
+    TEST_ASSERT_NOT_NULL_MESSAGE(cell, "MPMC queue should not be empty.");
+    TEST_ASSERT_EQUAL_MESSAGE(i, cell->packet.port, "MPMC queue packet is wrong.");
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, cell->packet.data, cell->packet.data_length, "MPMC queue data is wrong.");
+    kiss_mpmc_end_pop(&mpmc, cell);
+  }
+  TEST_ASSERT_NULL_MESSAGE(kiss_mpmc_begin_pop(&mpmc), "MPMC queue should be empty.");
+}
+
+void test_pool() {
+  static uint8_t arena[4096];
+  size_t sizes[] = {KISS_POOL_AX25_SIZE, 1024};
+  size_t counts[] = {4, 1};
+  kiss_pool_t pool;
+  TEST_ASSERT_TRUE_MESSAGE(kiss_pool_arena_size(sizes, counts, 2) <= sizeof(arena), "Arena is too small for the test.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_pool_init(&pool, arena, sizeof(arena), sizes, counts, 2), "Pool init failed.");
+  TEST_ASSERT_EQUAL_MESSAGE(-1, kiss_pool_init(&pool, arena, 64, sizes, counts, 2), "Pool init should fail with a small arena.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_pool_init(&pool, arena, sizeof(arena), sizes, counts, 2), "Pool init failed.");
+
+  kiss_packet_t *jumbo = kiss_pool_alloc(&pool, 1000);
+  TEST_ASSERT_NOT_NULL_MESSAGE(jumbo, "Jumbo buffer was not allocated.");
+  TEST_ASSERT_EQUAL_MESSAGE(1024, jumbo->data_capacity, "Jumbo buffer is the wrong size.");
+  TEST_ASSERT_NULL_MESSAGE(kiss_pool_alloc(&pool, 1000), "Only one jumbo buffer should exist.");
+
+  kiss_packet_t *p = kiss_pool_alloc(&pool, 100);
+  TEST_ASSERT_NOT_NULL_MESSAGE(p, "Small buffer was not allocated.");
+  TEST_ASSERT_EQUAL_MESSAGE(3, kiss_pool_available(&pool, 0), "Wrong number of small buffers free.");
+  kiss_pool_retain(p);
+  kiss_pool_release(p);
+  TEST_ASSERT_EQUAL_MESSAGE(3, kiss_pool_available(&pool, 0), "Buffer returned while still referenced.");
+  kiss_pool_release(p);
+  TEST_ASSERT_EQUAL_MESSAGE(4, kiss_pool_available(&pool, 0), "Buffer was not returned.");
+  kiss_pool_release(jumbo);
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_pool_available(&pool, 1), "Jumbo buffer was not returned.");
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+
+static void pipeline_handler(const kiss_packet_t *packet, void *context) {
+  if (packet->data_length == DECODED_DATA_LEN && memcmp(packet->data, DECODED_DATA, DECODED_DATA_LEN) == 0) {
+    __atomic_fetch_add((size_t *) context, 1, __ATOMIC_RELAXED);
+  }
+}
+
+void test_pipeline() {
+  int fds[2];
+  TEST_ASSERT_EQUAL_MESSAGE(0, pipe(fds), "Could not create pipe.");
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, write(fds[1], ENCODED_PACKET, ENCODED_PACKET_LEN), "Could not write to pipe.");
+  }
+  close(fds[1]);
+
+  size_t counts[2] = {0, 0};
+  kiss_pipeline_t pipeline;
+  kiss_pipeline_init(&pipeline, 256);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_pipeline_add_stream(&pipeline, fds[0], 64), "Could not add stream.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_pipeline_add_consumer(&pipeline, pipeline_handler, &counts[0], KISS_QUEUE_BLOCK, 8), "Could not add consumer.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_pipeline_add_consumer(&pipeline, pipeline_handler, &counts[1], KISS_QUEUE_BLOCK, 8), "Could not add consumer.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_pipeline_start(&pipeline), "Could not start pipeline.");
+  kiss_pipeline_wait(&pipeline);
+  // Both consumers shared one buffer per packet, and every buffer went back to the pool
+  TEST_ASSERT_EQUAL_MESSAGE(1 + 2 + 8 + 8, pipeline.pool.classes[0].count, "Pool is the wrong size.");
+  TEST_ASSERT_EQUAL_MESSAGE(pipeline.pool.classes[0].count, kiss_pool_available(&pipeline.pool, 0), "Buffers were not returned to the pool.");
+  kiss_pipeline_free(&pipeline);
+  close(fds[0]);
+  TEST_ASSERT_EQUAL_MESSAGE(100, counts[0], "First consumer missed packets.");
+  TEST_ASSERT_EQUAL_MESSAGE(100, counts[1], "Second consumer missed packets.");
+}
+
+struct parallel_result {
+  size_t frames;
+  size_t out_of_order;
+  uint8_t last_port;
+};
+
+static void parallel_handler(const kiss_packet_t *packet, void *context) {
+  struct parallel_result *r = (struct parallel_result *) context;
+  if (packet->port != (uint8_t) ((r->last_port + 1) % 12)) r->out_of_order++;
+  if (packet->data_length != DECODED_DATA_LEN || memcmp(packet->data, DECODED_DATA, DECODED_DATA_LEN) != 0) r->out_of_order++;
+  r->last_port = packet->port;
+  r->frames++;
+}
+
+void test_decode_parallel() {
+  uint8_t buffer[ENCODED_PACKET_LEN * 200];
+  // Consecutive packets count up through the ports so order can be checked.
+  // Port 12 is skipped because its data frame command byte is 0xC0.
+  for (size_t i = 0; i < 200; i++) {
+    memcpy(buffer + i * ENCODED_PACKET_LEN, ENCODED_PACKET, ENCODED_PACKET_LEN);
+    buffer[i * ENCODED_PACKET_LEN + 1] = kiss_encode_command(KISS_DATA_FRAME, i % 12);
+  }
+  struct parallel_result r = {.frames = 0, .out_of_order = 0, .last_port = 11};
+  kiss_parallel_options_t options = {.threads = 4, .chunk_size = 100, .ordered = 1};
+  long long frames = kiss_decode_parallel(buffer, sizeof(buffer), &options, parallel_handler, &r);
+  TEST_ASSERT_EQUAL_MESSAGE(200, frames, "Wrong number of frames decoded.");
+  TEST_ASSERT_EQUAL_MESSAGE(200, r.frames, "Wrong number of frames delivered.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, r.out_of_order, "Frames were delivered out of order or corrupted.");
+}
+
+void test_capture() {
+  char path[] = "/tmp/test_kiss_capture_XXXXXX";
+  int fd = mkstemp(path);
+  TEST_ASSERT_TRUE_MESSAGE(fd >= 0, "Could not create capture file.");
+  close(fd);
+
+  // Small blocks so the index has something to search
+  kiss_capture_writer_t writer;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_create(&writer, path, 128), "Could not create capture.");
+  for (uint64_t t = 0; t < 100; t++) {
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_write(&writer, t * 1000, &DECODED_PACKET), "Could not write frame.");
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_close(&writer), "Could not close capture.");
+
+  // Reopen and add more after a crash: a flushed block, then half of another
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_append(&writer, path, 128), "Could not reopen capture.");
+  for (uint64_t t = 100; t < 110; t++) kiss_capture_write(&writer, t * 1000, &DECODED_PACKET);
+  kiss_capture_flush(&writer);
+  lseek(writer.fd, 0, SEEK_END);
+  TEST_ASSERT_EQUAL_MESSAGE(7, write(writer.fd, ENCODED_PACKET, 7), "Could not write garbage.");
+  close(writer.fd);
+  free(writer.block);
+  free(writer.index);
+
+  kiss_capture_reader_t reader;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_open(&reader, path), "Could not open capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, reader.recovered, "Missing footer was not noticed.");
+  TEST_ASSERT_EQUAL_MESSAGE(110, reader.frames, "Wrong number of frames recovered.");
+  uint64_t t;
+  kiss_packet_t packet;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_seek(&reader, 50500), "Could not seek.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, kiss_capture_next(&reader, &t, &packet), "No frame after seek.");
+  TEST_ASSERT_EQUAL_MESSAGE(51000, t, "Seek found the wrong frame.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, packet.data, DECODED_DATA_LEN, "Data is wrong.");
+  size_t frames = 1;
+  while (kiss_capture_next(&reader, &t, &packet)) frames++;
+  TEST_ASSERT_EQUAL_MESSAGE(59, frames, "Wrong number of frames after seek.");
+  TEST_ASSERT_EQUAL_MESSAGE(-1, kiss_capture_seek(&reader, 200000), "Seek past the end succeeded.");
+  kiss_capture_close_reader(&reader);
+
+  // Appending cuts off the partial block and the file is whole again once closed
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_append(&writer, path, 128), "Could not recover capture.");
+  kiss_capture_write(&writer, 110000, &DECODED_PACKET);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_close(&writer), "Could not close capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_open(&reader, path), "Could not open capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, reader.recovered, "Footer was not written.");
+  TEST_ASSERT_EQUAL_MESSAGE(111, reader.frames, "Wrong number of frames.");
+  kiss_capture_close_reader(&reader);
+
+  // An index entry pointing outside the file is not trusted, even with a good checksum
+  fd = open(path, O_RDWR);
+  off_t size = lseek(fd, 0, SEEK_END);
+  uint8_t footer[KISS_CAPTURE_FOOTER_SIZE];
+  TEST_ASSERT_EQUAL_MESSAGE(sizeof(footer), pread(fd, footer, sizeof(footer), size - sizeof(footer)), "Could not read footer.");
+  off_t index_offset = footer[0] | footer[1] << 8 | footer[2] << 16;
+  size_t index_size = size - sizeof(footer) - index_offset;
+  uint8_t *index = malloc(index_size);
+  TEST_ASSERT_EQUAL_MESSAGE(index_size, pread(fd, index, index_size, index_offset), "Could not read index.");
+  index[16 + 2] = 0x10;
+  uint32_t checksum = 2166136261u;
+  for (size_t i = 0; i < index_size; i++) checksum = (checksum ^ index[i]) * 16777619u;
+  for (int i = 0; i < 4; i++) footer[28 + i] = (uint8_t) (checksum >> (8 * i));
+  pwrite(fd, index, index_size, index_offset);
+  pwrite(fd, footer, sizeof(footer), size - sizeof(footer));
+  close(fd);
+  free(index);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_open(&reader, path), "Could not open capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(1, reader.recovered, "Bad index was used.");
+  TEST_ASSERT_EQUAL_MESSAGE(111, reader.frames, "Wrong number of frames recovered.");
+  kiss_capture_close_reader(&reader);
+
+  // A frame bigger than a block gets its own block, and the blocks after it are the usual size again
+  uint8_t big_data[400] = {0};
+  kiss_packet_t big = kiss_new_packet(big_data, sizeof(big_data));
+  big.data_length = sizeof(big_data);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_create(&writer, path, 128), "Could not create capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_write(&writer, 0, &big), "Could not write big frame.");
+  for (uint64_t t = 1; t < 20; t++) kiss_capture_write(&writer, t, &DECODED_PACKET);
+  TEST_ASSERT_EQUAL_MESSAGE(128, writer.block_capacity, "Block did not shrink after a big frame.");
+  for (size_t i = 1; i < writer.index_count; i++) {
+    TEST_ASSERT_TRUE_MESSAGE(writer.index[i].length <= 128, "Block is bigger than the block size.");
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_close(&writer), "Could not close capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_open(&reader, path), "Could not open capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(20, reader.frames, "Wrong number of frames.");
+  kiss_capture_close_reader(&reader);
+  unlink(path);
+}
+#endif
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+struct loop_result {
+  size_t packets;
+  size_t closed;
+};
+
+static void loop_handler(const kiss_packet_t *packet, void *context) {
+  struct loop_result *r = context;
+  if (packet->data_length == DECODED_DATA_LEN && memcmp(packet->data, DECODED_DATA, DECODED_DATA_LEN) == 0) r->packets++;
+}
+
+static void loop_closed(int fd, int error, void *context) {
+  struct loop_result *r = context;
+  if (error == 0) r->closed++;
+  close(fd);
+}
+
+void test_loop() {
+  int fds[3][2];
+  struct loop_result r = {0, 0};
+  kiss_loop_t loop;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_loop_init(&loop, 256), "Could not create loop.");
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(0, pipe(fds[i]), "Could not create pipe.");
+    // The first stream already has data waiting when it is added
+    if (i == 0) TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, write(fds[i][1], ENCODED_PACKET, ENCODED_PACKET_LEN), "Could not write to pipe.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(kiss_loop_add(&loop, fds[i][0], loop_handler, loop_closed, &r), "Could not add stream.");
+  }
+  kiss_loop_run_once(&loop, 0);
+  for (int i = 0; i < 3; i++) {
+    // Split one packet across two writes on every stream
+    TEST_ASSERT_EQUAL_MESSAGE(7, write(fds[i][1], ENCODED_PACKET, 7), "Could not write to pipe.");
+  }
+  kiss_loop_run_once(&loop, 100);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN - 7, write(fds[i][1], ENCODED_PACKET + 7, ENCODED_PACKET_LEN - 7), "Could not write to pipe.");
+    close(fds[i][1]);
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_loop_run(&loop), "Loop failed.");
+  kiss_loop_free(&loop);
+  TEST_ASSERT_EQUAL_MESSAGE(4, r.packets, "Wrong number of packets handled.");
+  TEST_ASSERT_EQUAL_MESSAGE(3, r.closed, "Not every stream was closed.");
+}
+
+void test_server() {
+  kiss_server_options_t options = kiss_new_server_options();
+  options.port = 0;
+  options.queue_size = 4;
+  kiss_server_t server;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_server_init(&server, &options), "Could not start server.");
+  int tnc[2];
+  TEST_ASSERT_EQUAL_MESSAGE(0, socketpair(AF_UNIX, SOCK_STREAM, 0, tnc), "Could not create TNC socket.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_server_set_tnc(&server, tnc[0]), "Could not set TNC.");
+
+  int clients[2];
+  struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(kiss_server_port(&server)), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  for (int i = 0; i < 2; i++) {
+    clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_EQUAL_MESSAGE(0, connect(clients[i], (struct sockaddr *) &address, sizeof(address)), "Could not connect.");
+  }
+  for (int i = 0; i < 5 && server.client_count < 2; i++) kiss_server_run_once(&server, 100);
+  TEST_ASSERT_EQUAL_MESSAGE(2, server.client_count, "Clients were not accepted.");
+
+  // A frame from the TNC reaches every client
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, write(tnc[1], ENCODED_PACKET, ENCODED_PACKET_LEN), "Could not write to TNC.");
+  kiss_server_run_once(&server, 100);
+  for (int i = 0; i < 2; i++) {
+    uint8_t buffer[64];
+    TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, read(clients[i], buffer, sizeof(buffer)), "Client did not get the frame.");
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(ENCODED_PACKET, buffer, ENCODED_PACKET_LEN, "Client got the wrong frame.");
+  }
+
+  // A frame from a client reaches the TNC whole, even when split
+  TEST_ASSERT_EQUAL_MESSAGE(7, write(clients[0], ENCODED_PACKET, 7), "Could not write to server.");
+  kiss_server_run_once(&server, 100);
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN - 7, write(clients[0], ENCODED_PACKET + 7, ENCODED_PACKET_LEN - 7), "Could not write to server.");
+  for (int i = 0; i < 5 && server.stats.inbound == 0; i++) kiss_server_run_once(&server, 100);
+  uint8_t buffer[64];
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, read(tnc[1], buffer, sizeof(buffer)), "TNC did not get the frame.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(ENCODED_PACKET, buffer, ENCODED_PACKET_LEN, "TNC got the wrong frame.");
+
+  // Clients whose queues overflow are evicted
+  for (int i = 0; i < 5; i++) kiss_server_broadcast(&server, &DECODED_PACKET);
+  TEST_ASSERT_EQUAL_MESSAGE(2, server.stats.evicted, "Slow clients were not evicted.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, server.client_count, "Evicted clients are still connected.");
+
+  // The largest frame still fits a shared buffer when every byte, command included, is escaped
+  uint8_t fends[KISS_POOL_AX25_SIZE * 2];
+  memset(fends, KISS_FRAME_END, sizeof(fends));
+  kiss_packet_t big = kiss_new_packet(fends, sizeof(fends));
+  big.data_length = sizeof(fends);
+  big.port = 12;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_server_broadcast(&server, &big), "Largest frame was not broadcast.");
+
+  kiss_server_free(&server);
+  close(tnc[0]);
+  close(tnc[1]);
+  close(clients[0]);
+  close(clients[1]);
+}
+
+void test_shm() {
+  kiss_shm_t writer, mapping;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_shm_create(&writer, 0, 4, 256), "Could not create ring.");
+  // A second mapping of the same memory stands in for another process
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_shm_attach(&mapping, dup(writer.fd)), "Could not attach to ring.");
+  kiss_shm_reader_t fast = kiss_new_shm_reader(&mapping);
+  kiss_shm_reader_t slow = kiss_new_shm_reader(&mapping);
+  uint8_t buffer[256];
+  kiss_packet_t packet = kiss_new_packet(buffer, sizeof(buffer));
+
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_shm_wait(&fast, 0), "Empty ring has a frame.");
+  for (int i = 0; i < 10; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_shm_write(&writer, &DECODED_PACKET), "Could not write frame.");
+    TEST_ASSERT_EQUAL_MESSAGE(1, kiss_shm_wait(&fast, 100), "Reader was not woken.");
+    TEST_ASSERT_EQUAL_MESSAGE(1, kiss_shm_read(&fast, &packet), "Reader missed a frame.");
+    TEST_ASSERT_EQUAL_MESSAGE(DECODED_DATA_LEN, packet.data_length, "Data length is wrong.");
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, packet.data, packet.data_length, "Data is wrong.");
+  }
+
+  // The slow reader is told it fell behind, then carries on with what is left
+  TEST_ASSERT_EQUAL_MESSAGE(-1, kiss_shm_read(&slow, &packet), "Overrun was not detected.");
+  int frames = 0;
+  while (kiss_shm_peek(&slow, &packet) == 1) {
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, packet.data, DECODED_DATA_LEN, "Data is wrong.");
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_shm_release(&slow), "Frame was overwritten.");
+    frames++;
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(10, frames + slow.overruns, "Frames were lost without being counted.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_shm_read(&fast, &packet), "Reader got a frame twice.");
+
+  kiss_shm_close(&mapping);
+  kiss_shm_close(&writer);
+}
+
+// Reading, sending and capturing must work the same on either backend
+static void check_uring(kiss_uring_t *ring) {
+  int fds[2][2];
+  struct loop_result r = {0, 0};
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(0, pipe(fds[i]), "Could not create pipe.");
+    if (i == 0) TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, write(fds[i][1], ENCODED_PACKET, ENCODED_PACKET_LEN), "Could not write to pipe.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(kiss_uring_add(ring, fds[i][0], loop_handler, loop_closed, &r), "Could not add stream.");
+  }
+  for (int i = 0; i < 10 && r.packets < 1; i++) kiss_uring_run_once(ring, 100);
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(7, write(fds[i][1], ENCODED_PACKET, 7), "Could not write to pipe.");
+  }
+  kiss_uring_run_once(ring, 0);
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN - 7, write(fds[i][1], ENCODED_PACKET + 7, ENCODED_PACKET_LEN - 7), "Could not write to pipe.");
+  }
+  for (int i = 0; i < 10 && r.packets < 3; i++) kiss_uring_run_once(ring, 100);
+  TEST_ASSERT_EQUAL_MESSAGE(3, r.packets, "Wrong number of packets handled.");
+
+  // Queued frames go out on a stream that is only written to
+  int tnc[2];
+  TEST_ASSERT_EQUAL_MESSAGE(0, socketpair(AF_UNIX, SOCK_STREAM, 0, tnc), "Could not create TNC socket.");
+  kiss_uring_stream_t *out = kiss_uring_add(ring, tnc[0], 0, 0, 0);
+  TEST_ASSERT_NOT_NULL_MESSAGE(out, "Could not add stream.");
+  uint8_t tx_buffer[256];
+  kiss_tx_t tx;
+  kiss_tx_init(&tx, tx_buffer, sizeof(tx_buffer));
+  kiss_tx_queue(&tx, &DECODED_PACKET);
+  kiss_tx_queue(&tx, &DECODED_PACKET);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_send(ring, out, &tx), "Could not send.");
+  for (int i = 0; i < 10 && kiss_tx_length(&tx) > 0; i++) kiss_uring_run_once(ring, 100);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_tx_length(&tx), "Frames were not sent.");
+  uint8_t buffer[64];
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN * 2, read(tnc[1], buffer, sizeof(buffer)), "TNC did not get the frames.");
+  TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(ENCODED_PACKET, buffer + ENCODED_PACKET_LEN, ENCODED_PACKET_LEN, "TNC got the wrong frame.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_remove(ring, out), "Could not remove stream.");
+
+  // Full capture blocks are written in the background
+  char path[] = "/tmp/test_kiss_uring_XXXXXX";
+  int fd = mkstemp(path);
+  TEST_ASSERT_TRUE_MESSAGE(fd >= 0, "Could not create capture file.");
+  close(fd);
+  kiss_capture_writer_t writer;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_create(&writer, path, 128), "Could not create capture.");
+  for (uint64_t t = 0; t < 100; t++) {
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_capture(ring, &writer, t * 1000, &DECODED_PACKET), "Could not write frame.");
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_drain(ring), "Capture writes failed.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_close(&writer), "Could not close capture.");
+  kiss_capture_reader_t reader;
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_open(&reader, path), "Could not open capture.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, reader.recovered, "Footer was not written.");
+  uint64_t t;
+  kiss_packet_t packet;
+  size_t frames = 0;
+  while (kiss_capture_next(&reader, &t, &packet)) {
+    TEST_ASSERT_EQUAL_MESSAGE(frames * 1000, t, "Frame is out of place.");
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, packet.data, DECODED_DATA_LEN, "Data is wrong.");
+    frames++;
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(100, frames, "Wrong number of frames.");
+  kiss_capture_close_reader(&reader);
+
+  // Blocks whose background write fails are left out of the index
+  if (ring->backend == KISS_URING_IO_URING) {
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_create(&writer, path, 128), "Could not create capture.");
+    for (uint64_t t = 0; t < 20; t++) kiss_uring_capture(ring, &writer, t, &DECODED_PACKET);
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_drain(ring), "Capture writes failed.");
+    size_t written = writer.index_count;
+    int good = writer.fd;
+    writer.fd = open(path, O_RDONLY);
+    for (uint64_t t = 20; t < 40; t++) kiss_uring_capture(ring, &writer, t, &DECODED_PACKET);
+    TEST_ASSERT_EQUAL_MESSAGE(-1, kiss_uring_drain(ring), "Failed writes were not reported.");
+    close(writer.fd);
+    writer.fd = good;
+    TEST_ASSERT_EQUAL_MESSAGE(written, writer.index_count, "Failed blocks were added to the index.");
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_close(&writer), "Could not close capture.");
+    TEST_ASSERT_EQUAL_MESSAGE(0, kiss_capture_open(&reader, path), "Could not open capture.");
+    TEST_ASSERT_EQUAL_MESSAGE(0, reader.recovered, "Footer was not used.");
+    frames = 0;
+    while (kiss_capture_next(&reader, &t, &packet)) {
+      TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(DECODED_DATA, packet.data, DECODED_DATA_LEN, "Data is wrong.");
+      frames++;
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(reader.frames, frames, "Frame count does not match the frames in the index.");
+    kiss_capture_close_reader(&reader);
+  }
+  unlink(path);
+
+  for (int i = 0; i < 2; i++) close(fds[i][1]);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_run(ring), "Loop failed.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, r.closed, "Not every stream was closed.");
+
+  // Streams that reach end of file give their read buffers back
+  for (int i = 0; i < KISS_URING_BUFFERS + 8; i++) {
+    int p[2];
+    TEST_ASSERT_EQUAL_MESSAGE(0, pipe(p), "Could not create pipe.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(kiss_uring_add(ring, p[0], loop_handler, loop_closed, &r), "Could not add stream.");
+    close(p[1]);
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_run(ring), "Loop failed.");
+  TEST_ASSERT_EQUAL_MESSAGE(2 + KISS_URING_BUFFERS + 8, r.closed, "Not every stream was closed.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, pipe(fds[0]), "Could not create pipe.");
+  TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, write(fds[0][1], ENCODED_PACKET, ENCODED_PACKET_LEN), "Could not write to pipe.");
+  close(fds[0][1]);
+  TEST_ASSERT_NOT_NULL_MESSAGE(kiss_uring_add(ring, fds[0][0], loop_handler, loop_closed, &r), "Could not add stream.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_run(ring), "Loop failed.");
+  TEST_ASSERT_EQUAL_MESSAGE(4, r.packets, "Frame after many closed streams was not handled.");
+
+  // A regular file, like stdin redirected from a file, is read to the end even though epoll cannot watch it
+  char file_path[] = "/tmp/test_kiss_file_XXXXXX";
+  int file = mkstemp(file_path);
+  TEST_ASSERT_TRUE_MESSAGE(file >= 0, "Could not create file.");
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(ENCODED_PACKET_LEN, write(file, ENCODED_PACKET, ENCODED_PACKET_LEN), "Could not write to file.");
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(0, lseek(file, 0, SEEK_SET), "Could not rewind file.");
+  unlink(file_path);
+  TEST_ASSERT_NOT_NULL_MESSAGE(kiss_uring_add(ring, file, loop_handler, loop_closed, &r), "Could not add file.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_run(ring), "Loop failed.");
+  TEST_ASSERT_EQUAL_MESSAGE(6, r.packets, "Frames in the file were not handled.");
+  kiss_uring_free(ring);
+  close(tnc[0]);
+  close(tnc[1]);
+}
+
+void test_uring() {
+  kiss_uring_t ring;
+  // io_uring where the kernel has it, epoll otherwise
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_init(&ring, 256), "Could not create ring.");
+  check_uring(&ring);
+  TEST_ASSERT_EQUAL_MESSAGE(0, kiss_uring_init_epoll(&ring, 256), "Could not create epoll ring.");
+  TEST_ASSERT_EQUAL_MESSAGE(KISS_URING_EPOLL, ring.backend, "Wrong backend.");
+  check_uring(&ring);
+}
+#endif
+
 int runTests(void) {
     UNITY_BEGIN();
     RUN_TEST(test_encode_data);
     RUN_TEST(test_decode_data);
+    RUN_TEST(test_find_special);
+    RUN_TEST(test_scanners);
     RUN_TEST(test_encode_command);
     RUN_TEST(test_encode_packet);
+    RUN_TEST(test_encoded_length);
+    RUN_TEST(test_encode_packet_iov);
+    RUN_TEST(test_escaped_command);
     RUN_TEST(test_decode_packet);
     RUN_TEST(test_decode_padded_packet);
     RUN_TEST(test_decode_with_second_packet);
+    RUN_TEST(test_decode_packets);
+    RUN_TEST(test_decode_data_in_place);
+    RUN_TEST(test_decode_packet_in_place);
+    RUN_TEST(test_decoder_byte_at_a_time);
+    RUN_TEST(test_decoder_split_chunks);
+    RUN_TEST(test_decoder_stats);
+    RUN_TEST(test_decoder_fragments);
+    RUN_TEST(test_ax25_filter);
+    RUN_TEST(test_dedup);
+    RUN_TEST(test_crc);
+    RUN_TEST(test_tx);
+    RUN_TEST(test_ring_decode);
+    RUN_TEST(test_demux);
+    RUN_TEST(test_queues);
+    RUN_TEST(test_pool);
+#if defined(__unix__) || defined(__APPLE__)
+    RUN_TEST(test_pipeline);
+    RUN_TEST(test_decode_parallel);
+    RUN_TEST(test_capture);
+#endif
+#if defined(__linux__)
+    RUN_TEST(test_loop);
+    RUN_TEST(test_server);
+    RUN_TEST(test_shm);
+    RUN_TEST(test_uring);
+#endif
     return UNITY_END();
 }
 
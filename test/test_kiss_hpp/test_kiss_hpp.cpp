@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2022 Andrew C. Young (JJ1OKA / NU8W)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <kiss.hpp>
+#include <unity.h>
+
+#include <iterator>
+#include <vector>
+
+// The C++ interface must agree byte for byte with the C library
+
+struct Case {
+    kiss_command_t command;
+    uint8_t port;
+    std::vector<uint8_t> data;
+};
+
+static const std::vector<Case> CASES = {
+  {KISS_DATA_FRAME, 0, {'T', 'E', 'S', 'T'}},
+  {KISS_DATA_FRAME, 0, {'T', 0xC0, 0xDB, 0xDB, 0xC0}},
+  {KISS_DATA_FRAME, 12, {0xC0, 'A', 0xDB}},
+  {KISS_TX_DELAY, 13, {0x32}},
+  {KISS_DATA_FRAME, 3, {}},
+};
+
+// Escaped data, including invalid, repeated and trailing escapes
+static const std::vector<std::vector<uint8_t>> ENCODED = {
+  {},
+  {'A', 'B', 'C'},
+  {0xDB, 0xDC, 0xDB, 0xDD},
+  {'A', 0xDB, 'B'},
+  {'A', 0xDB, 0xDB, 0xDC},
+  {'A', 0xDB, 0xDB, 0xDB, 0xDD, 'B'},
+  {'A', 0xDB},
+  {'A', 0xDB, 0xDB},
+  {0xDB},
+};
+
+void test_encoder() {
+  for (const Case &c : CASES) {
+    kiss_packet_t p = kiss_new_packet(const_cast<uint8_t *>(c.data.data()), c.data.size());
+    p.command = c.command;
+    p.port = c.port;
+    p.data_length = c.data.size();
+    uint8_t expected[64];
+    size_t expected_len = kiss_encode_packet(p, expected, sizeof(expected));
+
+    kiss::Encoder encoder(c.command, c.port);
+    std::vector<uint8_t> out;
+    encoder.encode(c.data, std::back_inserter(out));
+    TEST_ASSERT_EQUAL_MESSAGE(expected_len, out.size(), "Encoded frame is the wrong length.");
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected, out.data(), expected_len, "Encoded frame is wrong.");
+    TEST_ASSERT_EQUAL_MESSAGE(kiss_encoded_length(&p), encoder.encoded_length(c.data), "Encoded length is wrong.");
+
+    uint8_t buffer[64];
+    kiss::span<const uint8_t> data(c.data.data(), c.data.size());
+    TEST_ASSERT_EQUAL_MESSAGE(expected_len, encoder.encode_into(data, kiss::span<uint8_t>(buffer, expected_len)), "Frame should fit exactly.");
+    TEST_ASSERT_EQUAL_MESSAGE(0, encoder.encode_into(data, kiss::span<uint8_t>(buffer, expected_len - 1)), "Frame should not fit.");
+  }
+}
+
+void test_decode_data() {
+  for (const std::vector<uint8_t> &encoded : ENCODED) {
+    uint8_t copy[64];
+    uint8_t expected[64];
+    uint8_t out[64];
+    std::copy(encoded.begin(), encoded.end(), copy);
+    size_t expected_len = kiss_decode_data(copy, encoded.size(), expected, sizeof(expected));
+    size_t len = kiss::decode_data(encoded, kiss::span<uint8_t>(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MESSAGE(expected_len, len, "Decoded data is the wrong length.");
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected, out, len, "Decoded data is wrong.");
+    if (len > 0) {
+      // Too small is reported apart from empty
+      TEST_ASSERT_EQUAL_MESSAGE(encoded.size() + 1, kiss::decode_data(encoded, kiss::span<uint8_t>(out, len - 1)), "Overflow was not reported.");
+    }
+  }
+}
+
+void test_decoder() {
+  std::vector<uint8_t> stream = {0xC0, 0xC0};
+  for (const Case &c : CASES) {
+    kiss::Encoder(c.command, c.port).encode(c.data, std::back_inserter(stream));
+  }
+  // Bad escapes inside frames, and an escape right before the end of one
+  for (const std::vector<uint8_t> &encoded : ENCODED) {
+    stream.push_back(0xC0);
+    stream.push_back(0x10);
+    stream.insert(stream.end(), encoded.begin(), encoded.end());
+    stream.push_back(0xC0);
+  }
+
+  for (size_t chunk : {size_t(1), size_t(3), stream.size()}) {
+    std::vector<std::vector<uint8_t>> expected, got;
+    uint8_t buffer[64];
+    kiss_decoder_t decoder = kiss_new_decoder(buffer, sizeof(buffer));
+    for (size_t i = 0; i < stream.size();) {
+      i += kiss_decoder_push(&decoder, stream.data() + i, stream.size() - i);
+      if (decoder.packet.complete_packet) {
+        std::vector<uint8_t> frame = {kiss_encode_command(decoder.packet.command, decoder.packet.port)};
+        frame.insert(frame.end(), decoder.packet.data, decoder.packet.data + decoder.packet.data_length);
+        expected.push_back(frame);
+      }
+    }
+
+    kiss::Decoder<64> cpp;
+    for (size_t i = 0; i < stream.size(); i += chunk) {
+      size_t n = std::min(chunk, stream.size() - i);
+      cpp.push(kiss::span<const uint8_t>(stream.data() + i, n), [&](const kiss::Frame &f) {
+        std::vector<uint8_t> frame = {kiss::encode_command(f.command, f.port)};
+        frame.insert(frame.end(), f.data.begin(), f.data.end());
+        got.push_back(frame);
+      });
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(CASES.size() + ENCODED.size(), expected.size(), "C decoder found the wrong number of frames.");
+    TEST_ASSERT_EQUAL_MESSAGE(expected.size(), got.size(), "Wrong number of frames.");
+    for (size_t i = 0; i < expected.size() && i < got.size(); i++) {
+      TEST_ASSERT_EQUAL_MESSAGE(expected[i].size(), got[i].size(), "Frame is the wrong length.");
+      TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected[i].data(), got[i].data(), expected[i].size(), "Frame is wrong.");
+    }
+  }
+}
+
+int runTests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_encoder);
+    RUN_TEST(test_decode_data);
+    RUN_TEST(test_decoder);
+    return UNITY_END();
+}
+
+void start() {
+  runTests();
+}
+
+void loop() {}
+
+int main() {
+  return runTests();
+}